@@ -0,0 +1,291 @@
+/**
+ * \file containers.cpp
+ * \brief Microbenchmarks of the containers of simulation_basis/utils, run
+ *        by a varying number of threads without MPI.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+
+#include "thread_safe_vector.hpp"
+#include "thread_safe_unordered_map.hpp"
+#include "fixed_size_multibuffer.hpp"
+#include "custom_heap.hpp"
+
+
+/// Agent identifiers and attributes, as in types.hpp
+typedef uint64_t AgentGlobalId;
+typedef uint64_t Attribute;
+
+/// Hash of the keys of the received attributes, as in types.hpp
+template <class T1, class T2>
+struct hash_pair {
+	size_t operator()(const std::pair<T1, T2> &p) const {
+		return std::hash<T1>()(p.first) ^ (std::hash<T2>()(p.second) << 1);
+	}
+};
+
+/// Interaction of payload bytes, stored behind a pointer as the interactions
+/// of the InteractionMatrix
+struct Payload {
+	explicit Payload(size_t size) : bytes(size) {}
+	std::vector<uint8_t> bytes;
+};
+
+/// Keeps the values read by the benchmarks from being optimized away
+volatile size_t sink;
+
+typedef utils::thread_safe_vector<std::unique_ptr<Payload>> PayloadVector;
+typedef utils::thread_safe_unordered_map<std::pair<AgentGlobalId, Attribute>, void*,
+	hash_pair<AgentGlobalId, Attribute>> AttributeMap;
+
+
+/**
+ * \fn double RunThreads(int nb_threads, const std::function<void(int)> &work)
+ * \brief Runs work(i) in nb_threads threads started together.
+ * \return The seconds between the start and the end of the slowest thread.
+ */
+double RunThreads(int nb_threads, const std::function<void(int)> &work) {
+	std::atomic<int> ready{0};
+	std::atomic<bool> go{false};
+	std::vector<std::thread> threads;
+	for (int i = 0; i < nb_threads; i++) {
+		threads.emplace_back([&, i]() {
+			ready++;
+			while (!go.load(std::memory_order_acquire)) {}
+			work(i);
+		});
+	}
+	while (ready.load() < nb_threads) {}
+	auto start = std::chrono::steady_clock::now();
+	go.store(true, std::memory_order_release);
+	for (auto &thread : threads) {
+		thread.join();
+	}
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * \fn void Report(const std::string &container, const std::string &operation, int nb_threads, size_t payload, size_t nb_operations, double seconds)
+ * \brief Prints a line of results in CSV.
+ */
+void Report(const std::string &container, const std::string &operation, int nb_threads,
+	size_t payload, size_t nb_operations, double seconds) {
+	std::cout << container << "," << operation << "," << nb_threads << "," << payload << ","
+	          << nb_operations << "," << seconds << "," << nb_operations/seconds/1e6 << std::endl;
+}
+
+
+/**
+ * \fn void BenchmarkVector(int nb_threads, size_t nb_operations, size_t payload)
+ * \brief Measures the concurrent push_back of interactions in a shared
+ *        thread_safe_vector, their concurrent reading, then clear.
+ */
+void BenchmarkVector(int nb_threads, size_t nb_operations, size_t payload) {
+	PayloadVector vector;
+	size_t per_thread = nb_operations/nb_threads;
+	double seconds = RunThreads(nb_threads, [&](int) {
+		for (size_t k = 0; k < per_thread; k++) {
+			vector.push_back(std::make_unique<Payload>(payload));
+		}
+	});
+	Report("thread_safe_vector", "push_back", nb_threads, payload, per_thread*nb_threads, seconds);
+
+	std::atomic<size_t> checksum{0};
+	seconds = RunThreads(nb_threads, [&](int i) {
+		size_t sum = 0;
+		auto lock = vector.shared_lock();
+		for (size_t k = i; k < vector.raw().size(); k += nb_threads) {
+			sum += vector.raw()[k]->bytes.size();
+		}
+		checksum += sum;
+	});
+	Report("thread_safe_vector", "read_locked", nb_threads, payload, vector.size(), seconds);
+
+	auto start = std::chrono::steady_clock::now();
+	size_t size = vector.size();
+	vector.clear();
+	Report("thread_safe_vector", "clear", 1, payload, size,
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+	start = std::chrono::steady_clock::now();
+	vector.resize(size);
+	Report("thread_safe_vector", "resize", 1, payload, size,
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	sink = checksum.load();
+}
+
+/**
+ * \fn void BenchmarkMap(int nb_threads, size_t nb_operations, size_t payload)
+ * \brief Measures the concurrent insertion of received attributes in a
+ *        shared thread_safe_unordered_map, then lookups with one insertion
+ *        every 16 operations, then clear.
+ */
+void BenchmarkMap(int nb_threads, size_t nb_operations, size_t payload) {
+	AttributeMap map;
+	size_t per_thread = nb_operations/nb_threads;
+	std::vector<std::vector<uint8_t>> values(nb_threads, std::vector<uint8_t>(payload));
+	double seconds = RunThreads(nb_threads, [&](int i) {
+		for (size_t k = 0; k < per_thread; k++) {
+			map.set(std::make_pair(k*nb_threads + i, k%4), values[i].data());
+		}
+	});
+	Report("thread_safe_unordered_map", "insert", nb_threads, payload, per_thread*nb_threads, seconds);
+
+	size_t nb_keys = per_thread*nb_threads;
+	std::atomic<size_t> found{0};
+	seconds = RunThreads(nb_threads, [&](int i) {
+		size_t local_found = 0;
+		uint64_t x = i + 1;
+		for (size_t k = 0; k < per_thread; k++) {
+			x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+			AgentGlobalId agent = x%nb_keys;
+			if (k%16 == 0) {
+				map.set(std::make_pair(agent + nb_keys, Attribute(0)), values[i].data());
+			} else if (map.get_if_exists(std::make_pair(agent, agent/nb_threads%4)).second) {
+				local_found++;
+			}
+		}
+		found += local_found;
+	});
+	Report("thread_safe_unordered_map", "lookup", nb_threads, payload, per_thread*nb_threads, seconds);
+
+	auto start = std::chrono::steady_clock::now();
+	size_t size = map.size();
+	map.clear();
+	Report("thread_safe_unordered_map", "clear", 1, payload, size,
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	sink = found.load();
+}
+
+/**
+ * \fn void BenchmarkMultibuffer(int nb_threads, size_t nb_operations, size_t payload)
+ * \brief Measures the resize of a fixed_size_multibuffer of interactions of
+ *        payload bytes, the concurrent writing of disjoint ranges as done by
+ *        the receptions, and clear.
+ */
+void BenchmarkMultibuffer(int nb_threads, size_t nb_operations, size_t payload) {
+	utils::fixed_size_multibuffer<uint8_t> buffer(payload);
+	auto start = std::chrono::steady_clock::now();
+	buffer.resize(nb_operations);
+	Report("fixed_size_multibuffer", "resize", 1, payload, nb_operations,
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+	std::vector<uint8_t> source(payload, 1);
+	size_t per_thread = nb_operations/nb_threads;
+	double seconds = RunThreads(nb_threads, [&](int i) {
+		for (size_t k = i*per_thread; k < (i + 1)*per_thread; k++) {
+			std::memcpy(buffer.void_pointer_to(k), source.data(), payload);
+		}
+	});
+	Report("fixed_size_multibuffer", "write", nb_threads, payload, per_thread*nb_threads, seconds);
+
+	start = std::chrono::steady_clock::now();
+	buffer.clear();
+	Report("fixed_size_multibuffer", "clear", 1, payload, nb_operations,
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
+
+/**
+ * \fn void BenchmarkHeap(int nb_threads, size_t nb_operations, size_t payload)
+ * \brief Measures the allocations of attributes of payload bytes in a
+ *        custom_heap owned by each thread (as each master owns one), then in a
+ *        custom_heap shared under a mutex, and clear.
+ */
+void BenchmarkHeap(int nb_threads, size_t nb_operations, size_t payload) {
+	size_t per_thread = nb_operations/nb_threads;
+	std::vector<utils::custom_heap> heaps(nb_threads);
+	double seconds = RunThreads(nb_threads, [&](int i) {
+		for (size_t k = 0; k < per_thread; k++) {
+			*static_cast<uint8_t*>(heaps[i].allocate(payload)) = 1;
+		}
+	});
+	Report("custom_heap", "allocate_private", nb_threads, payload, per_thread*nb_threads, seconds);
+
+	utils::custom_heap heap;
+	std::mutex mutex;
+	seconds = RunThreads(nb_threads, [&](int) {
+		for (size_t k = 0; k < per_thread; k++) {
+			std::lock_guard<std::mutex> lock(mutex);
+			*static_cast<uint8_t*>(heap.allocate(payload)) = 1;
+		}
+	});
+	Report("custom_heap", "allocate_locked", nb_threads, payload, per_thread*nb_threads, seconds);
+
+	auto start = std::chrono::steady_clock::now();
+	heap.clear();
+	Report("custom_heap", "clear", 1, payload, per_thread*nb_threads,
+		std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+	// The heap was cleared: its capacity is reused without malloc
+	seconds = RunThreads(1, [&](int) {
+		for (size_t k = 0; k < per_thread*nb_threads; k++) {
+			*static_cast<uint8_t*>(heap.allocate(payload)) = 1;
+		}
+	});
+	Report("custom_heap", "allocate_reused", 1, payload, per_thread*nb_threads, seconds);
+}
+
+
+int main(int argc, char* argv[]) {
+	std::vector<int> threads = {1, 2, 4, 8, 16, 32, 64};
+	std::vector<size_t> payloads = {16, 64, 256};
+	size_t nb_operations = 1 << 20;
+	std::string only = "";
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if ((arg == "--threads" || arg == "--payloads") && i + 1 < argc) {
+			std::vector<size_t> values;
+			char* list = argv[++i];
+			for (char* token = std::strtok(list, ","); token != nullptr; token = std::strtok(nullptr, ",")) {
+				values.push_back(std::strtoull(token, nullptr, 10));
+			}
+			if (arg == "--threads") {
+				threads.assign(values.begin(), values.end());
+			} else {
+				payloads = values;
+			}
+		} else if (arg == "--operations" && i + 1 < argc) {
+			nb_operations = std::strtoull(argv[++i], nullptr, 10);
+		} else if (arg == "--container" && i + 1 < argc) {
+			only = argv[++i];
+		} else {
+			std::cerr << "Usage: " << argv[0] << " [--threads <n,...>] [--payloads <bytes,...>]"
+			          << " [--operations <n>] [--container <vector|map|multibuffer|heap>]\n";
+			return 1;
+		}
+	}
+
+	const std::vector<std::pair<std::string, std::function<void(int, size_t, size_t)>>> benchmarks = {
+		{"vector", BenchmarkVector},
+		{"map", BenchmarkMap},
+		{"multibuffer", BenchmarkMultibuffer},
+		{"heap", BenchmarkHeap}};
+
+	std::cout << "container,operation,threads,payload_bytes,operations,seconds,mops_per_second" << std::endl;
+	for (const auto &benchmark : benchmarks) {
+		if (only != "" && only != benchmark.first) {
+			continue;
+		}
+		for (size_t payload : payloads) {
+			for (int nb_threads : threads) {
+				if (nb_threads > 0) {
+					benchmark.second(nb_threads, nb_operations, payload);
+				}
+			}
+		}
+	}
+	return 0;
+}
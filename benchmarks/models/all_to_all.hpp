@@ -0,0 +1,24 @@
+#ifndef ALL_TO_ALL_HPP_INCLUDED_
+#define ALL_TO_ALL_HPP_INCLUDED_
+
+#include <cstdint>
+#include "interaction.hpp"
+#include "agent.hpp"
+
+/* Random all-to-all benchmark: at every time step, each agent sends fanout
+ * interactions to agents drawn uniformly, so that almost all of them cross
+ * masters once there are several. */
+
+class Ping : public Interaction {
+public:
+	double value;
+};
+
+class Peer : public Agent {
+public:
+	double value;
+	uint64_t fanout;
+	uint64_t nb_received;
+};
+
+#endif
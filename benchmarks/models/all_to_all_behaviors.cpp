@@ -0,0 +1,28 @@
+#include "consts.hpp"
+#include "all_to_all.hpp"
+
+/// Mixes the bits of x (splitmix64), to draw the recipients without a shared
+/// random generator.
+static uint64_t Mix(uint64_t x) {
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30))*0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27))*0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+void Peer::Behavior() try {
+
+	for (const Ping &ping : received_Ping) {
+		value += ping.value;
+		nb_received++;
+	}
+	value *= 0.5;
+	uint64_t nb_peers = AgentIdTypeBound(Peer_type);
+	uint64_t seed = Mix(id_ ^ (TimeStep() << 32));
+	for (uint64_t i = 0; i < fanout; i++) {
+		Send(Peers[Mix(seed + i)%nb_peers], Ping(value));
+	}
+
+} catch (const std::exception &e) {
+	std::cerr << "[" << TimeStep() << "]" << " In agent Peer" << id_ << ": " << e.what() << std::endl;
+} catch (...) {}
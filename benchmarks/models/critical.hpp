@@ -0,0 +1,18 @@
+#ifndef CRITICAL_HPP_INCLUDED_
+#define CRITICAL_HPP_INCLUDED_
+
+#include "interaction.hpp"
+#include "agent.hpp"
+
+/* Critical-heavy benchmark: every agent modifies its critical attributes at
+ * every time step and reads the ones of its neighbors, so that all of them
+ * are synchronized between the masters at each step. */
+
+class Cell : public Agent {
+public:
+	$critical double load;
+	$critical double pressure;
+	double value;
+};
+
+#endif
@@ -0,0 +1,15 @@
+#include "consts.hpp"
+#include "critical.hpp"
+
+void Cell::Behavior() try {
+
+	uint64_t nb_cells = AgentIdTypeBound(Cell_type);
+	double next = Cells[(id_ + 1)%nb_cells].load;
+	double previous = Cells[(id_ + nb_cells - 1)%nb_cells].pressure;
+	value = 0.5*(next + previous);
+	load = 0.5*(load + value) + 1.0;
+	pressure = 0.5*(pressure + load);
+
+} catch (const std::exception &e) {
+	std::cerr << "[" << TimeStep() << "]" << " In agent Cell" << id_ << ": " << e.what() << std::endl;
+} catch (...) {}
@@ -0,0 +1,19 @@
+#ifndef REMOTE_READ_HPP_INCLUDED_
+#define REMOTE_READ_HPP_INCLUDED_
+
+#include <cstdint>
+#include "interaction.hpp"
+#include "agent.hpp"
+
+/* Remote-read-heavy benchmark: at every time step, each agent reads the
+ * public attribute of nb_reads agents drawn uniformly, without sending any
+ * interaction. */
+
+class Reader : public Agent {
+public:
+	double value;
+	uint64_t nb_reads;
+	double sum;
+};
+
+#endif
@@ -0,0 +1,25 @@
+#include "consts.hpp"
+#include "remote_read.hpp"
+
+/// Mixes the bits of x (splitmix64), to draw the agents read without a
+/// shared random generator.
+static uint64_t Mix(uint64_t x) {
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30))*0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27))*0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+void Reader::Behavior() try {
+
+	uint64_t nb_readers = AgentIdTypeBound(Reader_type);
+	uint64_t seed = Mix(id_ ^ (TimeStep() << 32));
+	sum = 0;
+	for (uint64_t i = 0; i < nb_reads; i++) {
+		sum += Readers[Mix(seed + i)%nb_readers].value;
+	}
+	value = 0.5*(value + sum/(nb_reads + 1));
+
+} catch (const std::exception &e) {
+	std::cerr << "[" << TimeStep() << "]" << " In agent Reader" << id_ << ": " << e.what() << std::endl;
+} catch (...) {}
@@ -0,0 +1,23 @@
+#ifndef RING_HPP_INCLUDED_
+#define RING_HPP_INCLUDED_
+
+#include <cstdint>
+#include "interaction.hpp"
+#include "agent.hpp"
+
+/* Nearest-neighbor benchmark: the agents form a ring and each one sends its
+ * value to its two neighbors at every time step. Most of the interactions
+ * stay on the same master when the agents are placed by blocks of ids. */
+
+class Token : public Interaction {
+public:
+	double value;
+};
+
+class RingNode : public Agent {
+public:
+	double value;
+	uint64_t nb_received;
+};
+
+#endif
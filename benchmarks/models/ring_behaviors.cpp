@@ -0,0 +1,16 @@
+#include "consts.hpp"
+#include "ring.hpp"
+
+void RingNode::Behavior() try {
+
+	for (const Token &token : received_Token) {
+		value = 0.5*(value + token.value);
+		nb_received++;
+	}
+	uint64_t nb_nodes = AgentIdTypeBound(RingNode_type);
+	Send(RingNodes[(id_ + 1)%nb_nodes], Token(value));
+	Send(RingNodes[(id_ + nb_nodes - 1)%nb_nodes], Token(value));
+
+} catch (const std::exception &e) {
+	std::cerr << "[" << TimeStep() << "]" << " In agent RingNode" << id_ << ": " << e.what() << std::endl;
+} catch (...) {}
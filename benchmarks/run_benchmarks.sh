@@ -0,0 +1,206 @@
+#!/bin/bash
+
+# Builds the synthetic models of models/ through the precompilation and runs
+# them in headless mode over a matrix of masters x threads x population sizes.
+# Each run appends a line to the results file:
+#   version,model,scaling,masters,threads,agents,steps,seconds_per_step
+# then the strong and weak scaling curves of this session are printed.
+#
+# Environment:
+#   STANDARD_DIR  path to the standard library includes of gcc (as in
+#                 precompilation.sh, guessed from g++ if empty)
+#   MPIRUN        MPI launcher (default: mpirun)
+#   MPIRUN_FLAGS  extra flags of the launcher (e.g. --oversubscribe)
+
+FOLDER=$(dirname `realpath $0`)
+PRECOMPIL="$FOLDER/../precompilation/bin/precompilation"
+WORK="$FOLDER/build"
+MPIRUN=${MPIRUN:-mpirun}
+
+MODELS="ring all_to_all critical remote_read"
+MASTERS="2 4 8"
+THREADS="1 2 4"
+SIZES="10000 100000"
+STEPS=50
+WARMUP=5
+REPEAT=3
+RESULTS="$FOLDER/results.csv"
+COMPARE=""
+BUILD=1
+
+usage() {
+	echo "Usage: $0 [options]"
+	echo "  -m <models>   models to run among: $MODELS"
+	echo "  -p <masters>  numbers of masters (default: \"$MASTERS\")"
+	echo "  -t <threads>  numbers of threads per master (default: \"$THREADS\")"
+	echo "  -n <sizes>    populations of the strong scaling runs, and per master"
+	echo "                and thread for the weak scaling runs (default: \"$SIZES\")"
+	echo "  -s <steps>    time steps measured per run (default: $STEPS)"
+	echo "  -w <steps>    time steps run before measuring (default: $WARMUP)"
+	echo "  -r <number>   runs per configuration, the fastest is kept (default: $REPEAT)"
+	echo "  -o <file>     results file, appended (default: results.csv)"
+	echo "  -c <file>     results of a previous version to compare with"
+	echo "  -k            keep the models built by a previous call"
+	exit 1
+}
+
+while getopts "m:p:t:n:s:w:r:o:c:kh" option; do
+	case $option in
+		m ) MODELS=$OPTARG;;
+		p ) MASTERS=$OPTARG;;
+		t ) THREADS=$OPTARG;;
+		n ) SIZES=$OPTARG;;
+		s ) STEPS=$OPTARG;;
+		w ) WARMUP=$OPTARG;;
+		r ) REPEAT=$OPTARG;;
+		o ) RESULTS=$(realpath "$OPTARG");;
+		c ) COMPARE=$(realpath "$OPTARG");;
+		k ) BUILD=0;;
+		* ) usage;;
+	esac
+done
+
+if [ "$STANDARD_DIR" = "" ]; then
+	STANDARD_DIR="/usr/include/c++/$(g++ -dumpversion)"
+fi
+
+# The step2 of the precompilation finds simulation_basis from the parent of
+# the working directory
+cd "$FOLDER"
+mkdir -p "$WORK"
+
+
+# Prints the instance of model with n agents on the standard output
+instance() {
+	local model=$1
+	local n=$2
+	case $model in
+		ring ) echo "{\"agent_types\": [{\"type\": \"RingNode\", \"number\": $n, \"default_values\": {\"value\": 1.0, \"nb_received\": 0}}]}";;
+		all_to_all ) echo "{\"agent_types\": [{\"type\": \"Peer\", \"number\": $n, \"default_values\": {\"value\": 1.0, \"fanout\": 4, \"nb_received\": 0}}]}";;
+		critical ) echo "{\"agent_types\": [{\"type\": \"Cell\", \"number\": $n, \"default_values\": {\"load\": 0.0, \"pressure\": 0.0, \"value\": 0.0}}]}";;
+		remote_read ) echo "{\"agent_types\": [{\"type\": \"Reader\", \"number\": $n, \"default_values\": {\"value\": 1.0, \"nb_reads\": 8, \"sum\": 0.0}}]}";;
+	esac
+}
+
+# Runs the precompilation and the compilation of model, as simulation-dev.sh
+# does without the edition steps
+build() {
+	local model=$1
+	local dir="$WORK/$model"
+	rm -rf "$dir" && mkdir -p "$dir"
+	echo "#pragma once" > "$dir/agent.hpp"
+	echo "#define \$critical" >> "$dir/agent.hpp"
+	echo "class Agent {};" >> "$dir/agent.hpp"
+	echo "#pragma once" > "$dir/interaction.hpp"
+	echo "class Interaction {};" >> "$dir/interaction.hpp"
+	cp "models/$model.hpp" "$dir/"
+
+	$PRECOMPIL -step1 -out-to-folder "${model}.hpp_step1" "$dir/$model.hpp" -- -std=c++14 "-I$STANDARD_DIR" || return 1
+	cp "models/${model}_behaviors.cpp" "$dir/${model}.hpp_step1/behaviors.cpp"
+	$PRECOMPIL -step2 -out-to-folder "../${model}.hpp_step2" -model-file "$model.hpp" "$dir/${model}.hpp_step1/behaviors.cpp" -- -std=c++14 "-I$STANDARD_DIR" || return 1
+
+	mkdir -p "$dir/build"
+	(cd "$dir/build" && cmake -DCMAKE_BUILD_TYPE=Release "../${model}.hpp_step2" > /dev/null && make -j$(nproc) > /dev/null) || return 1
+}
+
+# Prints the seconds per step of model with the given masters, threads and
+# agents, the fastest of the REPEAT runs
+measure() {
+	local model=$1 masters=$2 threads=$3 agents=$4
+	local instance_file="$WORK/$model/instance_$agents.json"
+	[ -f "$instance_file" ] || instance $model $agents > "$instance_file"
+	local best=""
+	for i in $(seq $REPEAT); do
+		local seconds=$($MPIRUN $MPIRUN_FLAGS -np $masters "$WORK/$model/build/bin/assasim-simulation" \
+			--commands "set_nb_threads $threads" "init $instance_file" "run $WARMUP" "run $STEPS" 2> /dev/null \
+			| grep "\"command\":\"run $STEPS\",\"status\":\"ok\"" | sed 's/.*"seconds":\([0-9.e+-]*\).*/\1/')
+		if [ "$seconds" = "" ]; then
+			echo "Run of $model failed with $masters masters, $threads threads and $agents agents" >&2
+			return 1
+		fi
+		best=$(awk -v best="$best" -v s="$seconds" 'BEGIN {print (best == "" || s < best) ? s : best}')
+	done
+	awk -v s="$best" -v n=$STEPS 'BEGIN {printf "%.9f\n", s/n}'
+}
+
+
+VERSION=$(git -C "$FOLDER" describe --always --dirty 2> /dev/null || echo unknown)
+[ -f "$RESULTS" ] || echo "version,model,scaling,masters,threads,agents,steps,seconds_per_step" > "$RESULTS"
+SESSION=$(mktemp)
+
+for model in $MODELS; do
+	if [ ! -f "models/$model.hpp" ]; then
+		echo "Unknown model $model" >&2
+		continue
+	fi
+	if [ $BUILD = 1 ] || [ ! -x "$WORK/$model/build/bin/assasim-simulation" ]; then
+		echo "-- Building $model --"
+		if ! build $model; then
+			echo "Build of $model failed" >&2
+			continue
+		fi
+	fi
+	echo "-- Running $model --"
+	for n in $SIZES; do
+		for masters in $MASTERS; do
+			for threads in $THREADS; do
+				# Strong scaling: the population is fixed
+				t=$(measure $model $masters $threads $n) && \
+					echo "$VERSION,$model,strong,$masters,$threads,$n,$STEPS,$t" | tee -a "$RESULTS" >> "$SESSION"
+				# Weak scaling: the population grows with the number of threads
+				agents=$((n*masters*threads))
+				t=$(measure $model $masters $threads $agents) && \
+					echo "$VERSION,$model,weak,$masters,$threads,$agents,$STEPS,$t" | tee -a "$RESULTS" >> "$SESSION"
+			done
+		done
+	done
+done
+
+
+# Scaling curves, relative to the configuration with the fewest threads in
+# total of each series (model and population, or population per thread)
+echo
+echo "model,scaling,agents_per_series,masters,threads,seconds_per_step,speedup,efficiency"
+sort -t, -k2,3 -k6n "$SESSION" | awk -F, '
+{
+	workers = $4*$5
+	series = $2 "," $3 "," ($3 == "strong" ? $6 : $6/workers)
+	if (!(series in base_workers) || workers < base_workers[series]) {
+		base_workers[series] = workers
+		base_time[series] = $8
+	}
+	lines[NR] = $0
+	series_of[NR] = series
+}
+END {
+	for (i = 1; i <= NR; i++) {
+		split(lines[i], f, ",")
+		s = series_of[i]
+		workers = f[4]*f[5]
+		speedup = base_time[s]/f[8]
+		if (f[3] == "strong") {
+			efficiency = speedup*base_workers[s]/workers
+		} else {
+			efficiency = speedup
+		}
+		printf "%s,%d,%d,%s,%.3f,%.3f\n", s, f[4], f[5], f[8], speedup, efficiency
+	}
+}'
+
+# Comparison with a previous version: ratio of the times per step of the same
+# configurations (above 1 means slower now)
+if [ "$COMPARE" != "" ]; then
+	echo
+	echo "model,scaling,masters,threads,agents,previous,current,ratio"
+	awk -F, 'NR == FNR {
+		if (FNR > 1) previous[$2 "," $3 "," $4 "," $5 "," $6] = $8
+		next
+	}
+	{
+		key = $2 "," $3 "," $4 "," $5 "," $6
+		if (key in previous)
+			printf "%s,%s,%s,%.3f\n", key, previous[key], $8, $8/previous[key]
+	}' "$COMPARE" "$SESSION"
+fi
+
+rm -f "$SESSION"
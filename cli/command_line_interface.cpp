@@ -6,29 +6,54 @@
 #include <cstdlib>
 #include <ctime>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iterator>
 #include <vector>
 #include <mpi.h>
 #include <memory>
 #include <boost/interprocess/ipc/message_queue.hpp>
+#include "bulk_channel.hpp"
 
 #include <readline/readline.h>
 #include <readline/history.h>
 
 std::unique_ptr<boost::interprocess::message_queue> mq_orders;
+// Channel of the payloads of the commands which do not fit in mq_orders
+std::unique_ptr<utils::bulk_channel> bulk_channel;
+// Capacity of the bulk channel in each direction (larger payloads are
+// streamed)
+const size_t bulk_capacity = 1 << 24;
 const char *run_cmd = "run";
 const char *exit_cmd = "exit";
 char buffer[1024];
 
 const char *help_msg = "Available commands:\n\
   + set_period <number>: determine how many step of the simulation is done\n\
-  + set_nb_threads <number>: determine how many threads are used - for each computing unit\n\
+  + set_nb_threads <number|auto>: determine how many threads are used - for each computing unit. Applies immediately to a running simulation; 'auto' lets each computing unit tune it from measured step times\n\
   + init <json_file>: initialize the simulation by loading the instanciation in the file given in options\n\
   + run (<number_of_steps>): run the simulation for period*number_of_steps. If the number of steps is not specified, run the simulation until receiving an order\n\
   + pause: pause the simulation\n\
   + kill: completely stop the simulation, freeing memory\n\
   + help: print this help message\n\
   + export_json <file.json>: export the snapshot of the state of the simulation in json\n\
+  + export_json_async <file.json>: same as export_json, but the file is written while the simulation goes on\n\
   + export_ubjson <file.json>: export the snapshot of the state of the simulation in binary json\n\
+  + print_agent <type> <id> (<attribute>...): print the attributes of one agent (only the given ones if any), without exporting the whole simulation\n\
+  + aggregate <type> <attribute> <count|sum|mean|min|max|histogram> (<number_of_bins>): compute a statistic of a numerical attribute over all the agents of a type, without exporting them\n\
+  + probe <type> <attribute> <count|sum|mean|min|max> <period> <file>: append the statistic to a binary time series (a 160-byte header naming the probe, then the time step as uint64 and the value as double) every period steps, without stalling the steps\n\
+  + probe_clear: remove all the probes\n\
+  + stats (<number_of_steps>): print the time spent in each phase of a step, the communications and the load imbalance of each computing unit over the last steps (all the recorded ones if not specified)\n\
+  + traffic <file.json|file.csv> (<number_of_steps>): write the number and bytes of the interactions of each type, MPI_Get and MPI_Put sent by each computing unit to each other one over the last steps (all the recorded ones if not specified), in json or in CSV according to the extension\n\
+  + timings (<number_of_steps>): print the median, 95th percentile, maximum and mean time per step of each phase and of each synchronization, as their minimum, average and maximum over the computing units, over the last steps (all the recorded ones if not specified)\n\
+  + attributes_profile <on|off>: start (discarding the previous counters) or stop counting the reads of attributes by type of reader, type of target and attribute\n\
+  + attributes_profile_dump <file.json|file.csv>: write the counters of the reads of attributes: critical, local, through shared memory, already received, replicated or fetched remotely, and the distinct remote agents read per step, in json or in CSV according to the extension\n\
+  + trace <on|off>: start (discarding the previous events) or stop recording the timeline of each thread of each computing unit\n\
+  + trace_dump <file.json>: write the recorded timeline in the Chrome trace event format, readable by chrome://tracing and Perfetto\n\
+  + add_agents <file.json>: add to the running simulation the agents described in the file, in the format of the instances, and print their identifiers\n\
+  + modify_attributes <file>: modify numerical attributes of agents, given one per line as '<type> <id> <attribute> <value>'\n\
+  + fetch_json <file.json|->: same as export_json, but the snapshot is written by this interface ('-' prints it)\n\
+  + probe_fetch <file.json|->: write the records of the probes whose file is '-' since the last probe_fetch\n\
   + convert <snapshot_init.json> <instance_output.json>: convert a file exported by the simulation to a file that can be given as initialisation\n\
   + quit/exit: kill the simulation and quit the program.";
 
@@ -43,8 +68,24 @@ const std::vector<const char*> commands = {
 	"set_period",
 	"set_nb_threads",
 	"export_json",
+	"export_json_async",
 	"export_ubjson",
 	"convert",
+	"add_agents",
+	"modify_attributes",
+	"fetch_json",
+	"probe_fetch",
+	"print_agent",
+	"aggregate",
+	"probe",
+	"probe_clear",
+	"stats",
+	"timings",
+	"traffic",
+	"attributes_profile",
+	"attributes_profile_dump",
+	"trace",
+	"trace_dump",
 	"help"
 };
 
@@ -144,26 +185,71 @@ void CommandLine() {
 		else {
 			std::string temp;
 			// Check that the correct number of arguments is passed to each command
-			if (command == "set_period" || command == "set_nb_threads" || command == "init" || command == "export_json" || command == "export_ubjson") {
+			if (command == "set_period" || command == "set_nb_threads" || command == "init" || command == "export_json" || command == "export_json_async" || command == "export_ubjson" || command == "trace" || command == "trace_dump" || command == "traffic" || command == "attributes_profile" || command == "attributes_profile_dump"
+				|| command == "add_agents" || command == "modify_attributes" || command == "fetch_json" || command == "probe_fetch") {
 				if (!(input >> temp)) {
 					std::cerr << "Wrong number of arguments! See help for further details." << std::endl;
 					continue;
 				}
-			} else if (command == "convert") {
+			} else if (command == "convert" || command == "print_agent") {
 				if (!(input >> temp) || !(input >> temp)) {
 					std::cerr << "Wrong number of arguments! See help for further details." << std::endl;
 					continue;
 				}
-			} else if (command != "run" && command != "pause" && command != "kill" && command != "help" && command != "quit" && command != "exit") {
+			} else if (command == "aggregate") {
+				if (!(input >> temp) || !(input >> temp) || !(input >> temp)) {
+					std::cerr << "Wrong number of arguments! See help for further details." << std::endl;
+					continue;
+				}
+			} else if (command == "probe") {
+				if (!(input >> temp) || !(input >> temp) || !(input >> temp) || !(input >> temp) || !(input >> temp)) {
+					std::cerr << "Wrong number of arguments! See help for further details." << std::endl;
+					continue;
+				}
+			} else if (command != "run" && command != "stats" && command != "timings" && command != "probe_clear" && command != "pause" && command != "kill" && command != "help" && command != "quit" && command != "exit") {
 				std::cerr << "Unknown command. See help for list of available commands." << std::endl;
 				continue;
 			}
 
+			// The payloads of the commands go through the bulk channel, and the
+			// file arguments are read or written by this interface
+			bool sends_payload = (command == "add_agents" || command == "modify_attributes");
+			bool receives_payload = sends_payload || command == "fetch_json" || command == "probe_fetch";
+			std::string file;
+			std::string payload;
+			if (receives_payload) {
+				std::istringstream arguments(buffer);
+				arguments >> temp >> file;
+			}
+			if (sends_payload) {
+				std::ifstream stream(file);
+				if (!stream) {
+					std::cerr << "Could not open the file " << file << "." << std::endl;
+					continue;
+				}
+				payload.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+			}
+
 			// Send a message to the simulation
 			mq_orders->send(buffer, (strlen(buffer)+1)*sizeof(char), 0);
 			if (command == "exit" ||  command == "quit") {
 				break;
 			}
+			if (sends_payload) {
+				bulk_channel->send(payload);
+			}
+			if (receives_payload) {
+				// An empty reply means that the command failed
+				bulk_channel->receive(payload);
+				if (payload.empty()) {
+					std::cerr << "The command failed." << std::endl;
+				} else if (sends_payload || file == "-") {
+					std::cout << payload << (payload.back() == '\n' ? "" : "\n");
+				} else {
+					std::ofstream stream(file);
+					stream << payload;
+				}
+			}
 		}
 
         free(buffer);
@@ -172,6 +258,7 @@ void CommandLine() {
 
     free(buffer);
 	boost::interprocess::message_queue::remove(mq_name.c_str());
+	bulk_channel.reset();
 }
 
 
@@ -226,6 +313,7 @@ int main(int argc, char* argv[]) {
 
 	boost::interprocess::message_queue::remove(mq_name.c_str());
 	mq_orders = std::make_unique<boost::interprocess::message_queue>(boost::interprocess::create_only, mq_name.c_str(), 100, 1023);
+	bulk_channel = std::make_unique<utils::bulk_channel>(boost::interprocess::create_only, mq_name + "_bulk", bulk_capacity);
 
 	if (argc == 1) {
 		std::cerr << "Interface launched in not-spawning mode. Communication token: " << input << "\n";
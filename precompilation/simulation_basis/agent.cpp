@@ -14,7 +14,8 @@
 
 
 Agent::Agent(AgentId id, AgentType type, MasterId master_id, Master& master) :
-	id_{id}, type_{type}, master_id_{master_id}, structure_{nullptr}
+	id_{id}, type_{type}, master_id_{master_id}, behavior_cost_{0}, handler_{nullptr}, dying_{false},
+	structure_{nullptr}
 {
 	master_ = &master;
 }
@@ -53,10 +54,28 @@ Time Agent::TimeStep() {
 
 
 void* Agent::AskAttribute(Attribute attr, AgentId recipient_id, AgentType recipient_type) {
-	return master_->GetAttribute(attr, recipient_id, recipient_type);
+	return master_->GetAttribute(attr, recipient_id, recipient_type, this);
 }
 
 
 void* Agent::AskConstant(std::string constant) {
 	return master_->GetConstant(constant);
 }
+
+
+AgentId Agent::CreateAgent(std::unique_ptr<Agent> &&child) {
+	child->id_ = handler_->NewAgentId(child->type_);
+	child->master_id_ = master_id_;
+	child->master_ = master_;
+	AgentId id = child->id_;
+	handler_->born_agents.push_back(std::move(child));
+	return id;
+}
+
+
+void Agent::Die() {
+	if (!dying_) {
+		dying_ = true;
+		handler_->dead_agents.push_back(std::make_pair(id_, type_));
+	}
+}
@@ -153,6 +153,25 @@ protected:
 	 */
 	std::vector<Attribute> updated_critical_attributes_;
 
+	/**
+	 * Traffic of the agent with the masters since the last migration round,
+	 * used to decide if it should migrate. Only modified by the thread
+	 * handling the agent.
+	 */
+	TrafficCounters traffic_;
+
+	/**
+	 * Moving average of the execution time (in seconds) of the Behavior of the
+	 * agent, used to balance the agents over the agent handlers of its master.
+	 */
+	double behavior_cost_;
+
+	/// Pointer to the agent handler which handles the agent.
+	AgentHandler* handler_;
+
+	/// Whether the agent called Die during the current time step.
+	bool dying_;
+
 	/**
 	 * Pointer to the data structure representing the agent class (used to
 	 * send it with MPI), which (virtually) inherits AgentStruct.
@@ -237,6 +256,29 @@ protected:
 	 */
 	void* AskConstant(std::string constant);
 
+	/**
+	 * \fn AgentId CreateAgent(std::unique_ptr<Agent> &&child)
+	 * \brief Adds a new agent to the simulation, on the master of this agent,
+	 *        at the beginning of the next time step.
+	 * \param child Double reference to the unique_ptr of the new agent, built
+	 *        with the complete constructor of its type (its identifier is
+	 *        ignored).
+	 * \return The local identifier given to the new agent.
+	 * \details The identifier may be the one of an agent which died during a
+	 * previous time step.
+	 * \warning child must not be used after the execution of this function.
+	 */
+	AgentId CreateAgent(std::unique_ptr<Agent> &&child);
+
+	/**
+	 * \fn void Die()
+	 * \brief Removes this agent from the simulation at the beginning of the
+	 *        next time step.
+	 * \details The interactions sent to this agent which were not delivered
+	 * yet are discarded.
+	 */
+	void Die();
+
 	/**
 	 * \fn virtual void Behavior()
 	 * \brief Main method of an agent, part of the model.
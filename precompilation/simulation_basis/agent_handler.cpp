@@ -3,11 +3,14 @@
  * \brief Impelments the methods of agent handlers.
  */
 
+#include <chrono>
+
 #include "types.hpp"
 #include "master.hpp"
 #include "interaction.hpp"
 #include "agent.hpp"
 #include "agent_handler.hpp"
+#include "heuristics.hpp"
 
 
 AgentHandler::AgentHandler(MasterId master_id, Master& master) : master_id{master_id} {
@@ -18,16 +21,52 @@ AgentHandler::AgentHandler(MasterId master_id, Master& master) : master_id{maste
 Agent* AgentHandler::AddAgent(std::unique_ptr<Agent> &&agent) {
 	AgentId agent_local_id = agent->id_;
 	AgentType agent_type = agent->type_;
+	agent->handler_ = this;
 	agents.insert(std::make_pair(std::make_pair(agent_local_id, agent_type), std::forward<std::unique_ptr<Agent>>(agent)));
 	return agents.at({agent_local_id, agent_type}).get();
 }
 
 
+AgentId AgentHandler::NewAgentId(AgentType type) {
+	std::vector<AgentId> &ids = free_ids[type];
+	if (ids.empty()) {
+		return master->FreshAgentId(type);
+	}
+	AgentId id = ids.back();
+	ids.pop_back();
+	return id;
+}
+
+
+std::unique_ptr<Agent> AgentHandler::ExtractAgent(AgentId id, AgentType type) {
+	auto it = agents.find({id, type});
+	std::unique_ptr<Agent> agent = std::move(it->second);
+	agents.erase(it);
+	return agent;
+}
+
+
 void AgentHandler::RunBehaviors() {
+	// The costs are only measured in the time steps ending with a balancing
+	if (master->TimeStep()%HANDLERS_BALANCING_PERIOD != 0) {
+		for (auto& agent : agents) {
+			agent.second->Behavior();
+			agent.second->ResetMessages();
+			agent.second->CheckModifiedCriticalAttributes();
+		}
+		return;
+	}
+	// The end of the behavior of an agent is the start of the next one, so
+	// that each agent costs one clock read
+	auto start = std::chrono::steady_clock::now();
 	for (auto& agent : agents) {
 		agent.second->Behavior();
 		agent.second->ResetMessages();
 		agent.second->CheckModifiedCriticalAttributes();
+		auto end = std::chrono::steady_clock::now();
+		std::chrono::duration<double> cost = end - start;
+		agent.second->behavior_cost_ += BEHAVIOR_COST_SMOOTHING*(cost.count() - agent.second->behavior_cost_);
+		start = end;
 	}
 }
 
@@ -61,3 +100,12 @@ void AgentHandler::GetJsonNodes(std::vector<ubjson::Value> &local_agents_by_type
 		local_agents_by_types.at(agent.second->type_).push_back(std::move(agent_json));
 	}
 }
+
+
+void AgentHandler::AggregateAttribute(AgentType type, Attribute attr, AttributeReader read, AttributeAggregate &aggregate) {
+	for (auto& agent : agents) {
+		if (agent.second->type_ == type) {
+			aggregate.Add(read(agent.second->GetPointerToAttribute(attr)));
+		}
+	}
+}
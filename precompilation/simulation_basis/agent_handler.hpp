@@ -44,6 +44,26 @@ public:
 	/// Agents held by this agent handler.
 	AgentContainer agents;
 
+	/// Agents created by the agents of this agent handler during the current
+	/// time step, added to the simulation by Master::MetaEvolution.
+	std::vector<std::unique_ptr<Agent>> born_agents;
+
+	/// Agents of this agent handler which died during the current time step.
+	std::vector<std::pair<AgentId, AgentType>> dead_agents;
+
+	/// Identifiers which can be given to new agents, by type.
+	std::unordered_map<AgentType, std::vector<AgentId>> free_ids;
+
+	/**
+	 * \fn AgentId NewAgentId(AgentType type)
+	 * \brief Gives an unused identifier for a new agent of type type.
+	 * \param type Type identifier of the new agent.
+	 * \return The local identifier of the new agent.
+	 * \details Recycles an identifier of free_ids if possible, and asks its
+	 * master for a fresh one otherwise.
+	 */
+	AgentId NewAgentId(AgentType type);
+
 	/**
 	 * \fn void AddAgent(std::unique_ptr<Agent> &&agent)
 	 * \brief Adds an agent to this agent handler and releases its unique_ptr.
@@ -55,9 +75,21 @@ public:
 	 */
 	Agent* AddAgent(std::unique_ptr<Agent> &&agent);
 
+	/**
+	 * \fn std::unique_ptr<Agent> ExtractAgent(AgentId id, AgentType type)
+	 * \brief Removes an agent from this agent handler without deleting it.
+	 * \param id Local identifier of the agent to remove.
+	 * \param type Type identifier of the agent to remove.
+	 * \return The unique_ptr of the removed agent.
+	 */
+	std::unique_ptr<Agent> ExtractAgent(AgentId id, AgentType type);
+
 	/**
 	 * \fn void RunBehaviors()
 	 * \brief Runs the Behaviors of all agents in this thread.
+	 * \details In the time steps which end with a balancing of the agent
+	 * handlers (every HANDLERS_BALANCING_PERIOD time steps), the execution
+	 * time of each agent is measured to update its behavior_cost_.
 	 */
 	void RunBehaviors();
 
@@ -89,6 +121,17 @@ public:
 	 */
 	void GetJsonNodes(std::vector<ubjson::Value> &local_agents_by_types);
 
+	/**
+	 * \fn void AggregateAttribute(AgentType type, Attribute attr, AttributeReader read, AttributeAggregate &aggregate)
+	 * \brief Adds to aggregate the value of an attribute of all the agents of
+	 *        a type in this agent handler.
+	 * \param type Type identifier of the aggregated agents.
+	 * \param attr Attribute identifier of the aggregated attribute.
+	 * \param read Function reading the attribute as a double.
+	 * \param aggregate Aggregate to which the values are added.
+	 */
+	void AggregateAttribute(AgentType type, Attribute attr, AttributeReader read, AttributeAggregate &aggregate);
+
 };
 
 #endif
@@ -3,6 +3,11 @@
  * \brief Implements the heuristics of heuristics.hpp.
  */
 
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+#include <map>
+#include <limits>
 
 #include "heuristics.hpp"
 
@@ -18,11 +23,277 @@ void NaiveInitialMastersAssignement(
 }
 
 
+/*
+ * Cuts order in nb_masters ranges of equal weight: the middle of an agent in the
+ * cumulated weight decides its range. Fills assignment and the weight of each
+ * master in loads.
+ */
+static void CutOrderInRanges(
+	std::vector<size_t> &order, std::vector<uint64_t> &weights, uint64_t total_weight,
+	std::vector<MasterId> &assignment, std::vector<uint64_t> &loads, MasterId nb_masters)
+{
+	loads.assign(nb_masters, 0);
+	uint64_t cumulated_weight = 0;
+	for (size_t agent : order) {
+		MasterId master = (2*cumulated_weight + weights.at(agent)) * nb_masters / (2*total_weight);
+		master = std::min(master, nb_masters-1);
+		assignment.at(agent) = master;
+		loads.at(master) += weights.at(agent);
+		cumulated_weight += weights.at(agent);
+	}
+}
+
+
+/*
+ * Index on the Hilbert or Morton curve of the point of coordinates x, each
+ * coordinate being written on bits bits (x is modified).
+ */
+static uint64_t CurveIndex(std::vector<uint64_t> &x, int bits, bool hilbert) {
+	size_t n = x.size();
+	if (hilbert) {
+		// Transposed Hilbert index (J. Skilling, "Programming the Hilbert
+		// curve", 2004)
+		uint64_t m = uint64_t(1) << (bits-1);
+		for (uint64_t q=m; q>1; q>>=1) {
+			uint64_t p = q-1;
+			for (size_t i=0; i<n; i++) {
+				if (x[i] & q) {
+					x[0] ^= p;
+				} else {
+					uint64_t t = (x[0]^x[i]) & p;
+					x[0] ^= t;
+					x[i] ^= t;
+				}
+			}
+		}
+		for (size_t i=1; i<n; i++) {
+			x[i] ^= x[i-1];
+		}
+		uint64_t t = 0;
+		for (uint64_t q=m; q>1; q>>=1) {
+			if (x[n-1] & q) {
+				t ^= q-1;
+			}
+		}
+		for (size_t i=0; i<n; i++) {
+			x[i] ^= t;
+		}
+	}
+	// Interleaving of the bits of the coordinates
+	uint64_t index = 0;
+	for (int b=bits-1; b>=0; b--) {
+		for (size_t i=0; i<n; i++) {
+			index = (index << 1) | ((x[i] >> b) & 1);
+		}
+	}
+	return index;
+}
+
+
+void GraphInitialMastersAssignement(
+	std::vector<void*> &initial_agents,
+	std::vector<AgentEdge> &edges, std::vector<uint64_t> &weights,
+	std::vector<MasterId> &assignment, std::vector<size_t> &order, MasterId nb_masters)
+{
+	size_t nb_agents = initial_agents.size();
+	uint64_t total_weight = 0;
+	for (size_t k=0; k<nb_agents; k++) {
+		total_weight += weights.at(k);
+	}
+	if (nb_agents == 0 || total_weight == 0 || nb_masters == 1) {
+		NaiveInitialMastersAssignement(initial_agents, assignment, nb_masters);
+		order.resize(nb_agents);
+		for (size_t k=0; k<nb_agents; k++) {
+			order.at(k) = k;
+		}
+		return;
+	}
+
+	// Compressed adjacency lists of the (undirected) interaction graph:
+	// neighbors of agent k are neighbors[begin[k]..begin[k+1]]
+	std::vector<size_t> begin(nb_agents+1, 0);
+	for (auto &edge : edges) {
+		if (edge.source == edge.target || edge.source >= nb_agents || edge.target >= nb_agents)
+			continue;
+		begin.at(edge.source+1)++;
+		begin.at(edge.target+1)++;
+	}
+	for (size_t k=0; k<nb_agents; k++) {
+		begin.at(k+1) += begin.at(k);
+	}
+	std::vector<size_t> neighbors(begin.back());
+	std::vector<uint64_t> edge_weights(begin.back());
+	std::vector<size_t> filled(begin.begin(), begin.end()-1);
+	for (auto &edge : edges) {
+		if (edge.source == edge.target || edge.source >= nb_agents || edge.target >= nb_agents)
+			continue;
+		neighbors.at(filled.at(edge.source)) = edge.target;
+		edge_weights.at(filled.at(edge.source)++) = edge.weight;
+		neighbors.at(filled.at(edge.target)) = edge.source;
+		edge_weights.at(filled.at(edge.target)++) = edge.weight;
+	}
+
+	// Breadth-first order of the agents, so that connected agents are close
+	order.clear();
+	order.reserve(nb_agents);
+	std::vector<bool> visited(nb_agents, false);
+	for (size_t root=0; root<nb_agents; root++) {
+		if (visited.at(root))
+			continue;
+		visited.at(root) = true;
+		size_t head = order.size();
+		order.push_back(root);
+		while (head < order.size()) {
+			size_t agent = order.at(head++);
+			for (size_t e=begin.at(agent); e<begin.at(agent+1); e++) {
+				if (!visited.at(neighbors.at(e))) {
+					visited.at(neighbors.at(e)) = true;
+					order.push_back(neighbors.at(e));
+				}
+			}
+		}
+	}
+
+	// Initial assignment: the order is cut in ranges of equal weight
+	std::vector<uint64_t> loads;
+	CutOrderInRanges(order, weights, total_weight, assignment, loads, nb_masters);
+
+	// Refinement by label propagation: an agent moves to the master to which
+	// it is the most connected if it strictly decreases the cut, without
+	// taking its master below min_load nor the other one above max_load
+	uint64_t max_weight = *std::max_element(weights.begin(), weights.end());
+	uint64_t max_load = std::max<uint64_t>(
+		std::ceil((1+MASTERS_IMBALANCE) * total_weight / nb_masters),
+		total_weight / nb_masters + max_weight);
+	uint64_t min_load = std::floor((1-MASTERS_IMBALANCE) * total_weight / nb_masters);
+	std::vector<uint64_t> connections(nb_masters, 0);
+	std::vector<MasterId> touched;
+	for (int pass=0; pass<MAX_LABEL_PROPAGATION_PASSES; pass++) {
+		size_t nb_moves = 0;
+		for (size_t agent : order) {
+			MasterId current = assignment.at(agent);
+			for (size_t e=begin.at(agent); e<begin.at(agent+1); e++) {
+				MasterId master = assignment.at(neighbors.at(e));
+				if (connections.at(master) == 0)
+					touched.push_back(master);
+				connections.at(master) += edge_weights.at(e);
+			}
+			MasterId best = current;
+			uint64_t best_connection = connections.at(current);
+			bool can_leave = loads.at(current) >= min_load + weights.at(agent);
+			for (MasterId master : touched) {
+				if (!can_leave || master == current || loads.at(master) + weights.at(agent) > max_load)
+					continue;
+				if (connections.at(master) > best_connection
+					|| (connections.at(master) == best_connection && best != current
+						&& loads.at(master) < loads.at(best)))
+				{
+					best = master;
+					best_connection = connections.at(master);
+				}
+			}
+			if (best != current) {
+				loads.at(current) -= weights.at(agent);
+				loads.at(best) += weights.at(agent);
+				assignment.at(agent) = best;
+				nb_moves++;
+			}
+			for (MasterId master : touched) {
+				connections.at(master) = 0;
+			}
+			touched.clear();
+		}
+		if (nb_moves == 0)
+			break;
+	}
+}
+
+
+void CurveInitialMastersAssignement(
+	std::vector<void*> &initial_agents,
+	std::vector<std::vector<double>> &coordinates, std::vector<uint64_t> &weights,
+	std::vector<MasterId> &assignment, std::vector<size_t> &order, MasterId nb_masters,
+	bool hilbert)
+{
+	size_t nb_agents = initial_agents.size();
+	uint64_t total_weight = 0;
+	size_t nb_dimensions = 0;
+	for (size_t k=0; k<nb_agents; k++) {
+		total_weight += weights.at(k);
+		nb_dimensions = std::max(nb_dimensions, coordinates.at(k).size());
+	}
+	nb_dimensions = std::min(nb_dimensions, MAX_CURVE_DIMENSIONS);
+
+	// Bounding box of the agents with coordinates
+	std::vector<double> lower(nb_dimensions, std::numeric_limits<double>::max());
+	std::vector<double> upper(nb_dimensions, std::numeric_limits<double>::lowest());
+	for (size_t k=0; k<nb_agents; k++) {
+		if (coordinates.at(k).size() < nb_dimensions)
+			continue;
+		for (size_t i=0; i<nb_dimensions; i++) {
+			lower.at(i) = std::min(lower.at(i), coordinates.at(k).at(i));
+			upper.at(i) = std::max(upper.at(i), coordinates.at(k).at(i));
+		}
+	}
+
+	// Indices on the curve (agents without coordinates come last)
+	int bits = nb_dimensions == 0 ? 1 : std::min<int>(32, 64/nb_dimensions);
+	double grid_size = (double)((uint64_t(1) << bits) - 1);
+	std::vector<std::pair<bool, uint64_t>> keys(nb_agents, std::make_pair(true, 0));
+	std::vector<uint64_t> x(nb_dimensions);
+	for (size_t k=0; k<nb_agents; k++) {
+		if (nb_dimensions == 0 || coordinates.at(k).size() < nb_dimensions)
+			continue;
+		for (size_t i=0; i<nb_dimensions; i++) {
+			double extent = upper.at(i) - lower.at(i);
+			x.at(i) = extent > 0 ? (uint64_t)((coordinates.at(k).at(i) - lower.at(i)) / extent * grid_size) : 0;
+		}
+		keys.at(k) = std::make_pair(false, CurveIndex(x, bits, hilbert));
+	}
+
+	order.resize(nb_agents);
+	for (size_t k=0; k<nb_agents; k++) {
+		order.at(k) = k;
+	}
+	std::stable_sort(order.begin(), order.end(),
+		[&keys](size_t a, size_t b) { return keys.at(a) < keys.at(b); });
+
+	if (total_weight == 0) {
+		NaiveInitialMastersAssignement(initial_agents, assignment, nb_masters);
+		return;
+	}
+	std::vector<uint64_t> loads;
+	CutOrderInRanges(order, weights, total_weight, assignment, loads, nb_masters);
+}
+
+
 void AssignInitialMasters(
 	std::vector<void*> &initial_agents,
-	std::vector<MasterId> &assignment, MasterId nb_masters)
+	std::vector<AgentEdge> &edges, std::vector<uint64_t> &weights,
+	std::vector<std::vector<double>> &coordinates, PlacementHeuristic heuristic,
+	std::vector<MasterId> &assignment, std::vector<size_t> &order, MasterId nb_masters)
 {
-	NaiveInitialMastersAssignement(initial_agents, assignment, nb_masters);
+	if (heuristic == PlacementHeuristic::Automatic) {
+		bool uniform_weights = std::all_of(weights.begin(), weights.end(),
+			[](uint64_t weight) { return weight == 1; });
+		heuristic = (edges.empty() && uniform_weights) ? PlacementHeuristic::Naive : PlacementHeuristic::Graph;
+	}
+	switch (heuristic) {
+		case PlacementHeuristic::Graph:
+			GraphInitialMastersAssignement(initial_agents, edges, weights, assignment, order, nb_masters);
+			break;
+		case PlacementHeuristic::Hilbert:
+		case PlacementHeuristic::Morton:
+			CurveInitialMastersAssignement(initial_agents, coordinates, weights, assignment, order, nb_masters,
+				heuristic == PlacementHeuristic::Hilbert);
+			break;
+		default:
+			NaiveInitialMastersAssignement(initial_agents, assignment, nb_masters);
+			order.resize(initial_agents.size());
+			for (size_t k=0; k<order.size(); k++) {
+				order.at(k) = k;
+			}
+	}
 }
 
 
@@ -37,13 +308,200 @@ void NaiveInitialAgentHandlersAssignement(
 }
 
 
+void ContiguousInitialAgentHandlersAssignement(
+   utils::fixed_size_multibuffer<AgentStruct> &initial_agents,
+   std::vector<size_t> &assignment, size_t nb_agent_handlers)
+{
+	size_t nb_agents = initial_agents.size();
+	for (size_t k=0; k<nb_agents; k++) {
+		assignment[k] = k*nb_agent_handlers/nb_agents;
+	}
+}
+
+
 void AssignInitialAgentHandlers(
    utils::fixed_size_multibuffer<AgentStruct> &initial_agents,
    std::vector<size_t> &assignment, size_t nb_agent_handlers)
 {
-	NaiveInitialAgentHandlersAssignement(initial_agents, assignment, nb_agent_handlers);
+	ContiguousInitialAgentHandlersAssignement(initial_agents, assignment, nb_agent_handlers);
 }
 
-void MigrateAgents() {
-	// Fill MetaEvolutionDescriptions with all the migrations needed, using a given heuristic
+void RebalanceAgentHandlers(std::vector<double> &costs,
+	std::vector<size_t> &assignment, size_t nb_agent_handlers)
+{
+	size_t nb_agents = costs.size();
+	double total_cost = 0;
+	std::vector<double> loads(nb_agent_handlers, 0);
+	std::vector<std::multimap<double, size_t>> agents_by_cost(nb_agent_handlers);
+	for (size_t k=0; k<nb_agents; k++) {
+		total_cost += costs[k];
+		loads[assignment[k]] += costs[k];
+		agents_by_cost[assignment[k]].emplace(costs[k], k);
+	}
+	double max_load = (1+HANDLERS_IMBALANCE)*total_cost/nb_agent_handlers;
+
+	for (size_t moves=0; moves<nb_agents; moves++) {
+		size_t heaviest = std::max_element(loads.begin(), loads.end()) - loads.begin();
+		size_t lightest = std::min_element(loads.begin(), loads.end()) - loads.begin();
+		if (loads[heaviest] <= max_load) {
+			break;
+		}
+
+		// Moving an agent of cost c lowers the maximum of both loads if
+		// 0 < c < gap, and the most if c is close to gap/2
+		double gap = loads[heaviest] - loads[lightest];
+		auto &candidates = agents_by_cost[heaviest];
+		auto it = candidates.lower_bound(gap/2);
+		auto best = candidates.end();
+		if (it != candidates.end() && it->first < gap) {
+			best = it;
+		}
+		if (it != candidates.begin()) {
+			auto before = std::prev(it);
+			if (before->first > 0 && (best == candidates.end() || gap/2 - before->first < best->first - gap/2)) {
+				best = before;
+			}
+		}
+		if (best == candidates.end()) {
+			break;
+		}
+
+		size_t agent = best->second;
+		candidates.erase(best);
+		agents_by_cost[lightest].emplace(costs[agent], agent);
+		loads[heaviest] -= costs[agent];
+		loads[lightest] += costs[agent];
+		assignment[agent] = lightest;
+	}
+}
+
+
+void MigrateAgents(MasterId master_id, Time round,
+	std::vector<std::pair<AgentGlobalId, TrafficCounters>> &traffics,
+	std::vector<size_t> &nb_agents_by_master,
+	std::vector<MetaEvolutionDescription> &migrations)
+{
+	MasterId nb_masters = nb_agents_by_master.size();
+	if (nb_masters < 2) {
+		return;
+	}
+	bool upwards = (round%2 == 0);
+
+	size_t nb_agents = 0;
+	for (size_t n : nb_agents_by_master) {
+		nb_agents += n;
+	}
+	double average = (double) nb_agents / nb_masters;
+	size_t max_load = std::floor(average*(1+MIGRATION_IMBALANCE));
+	size_t min_load = std::ceil(average*(1-MIGRATION_IMBALANCE));
+
+	// Arrivals allowed on each master from this one, and departures allowed
+	std::vector<size_t> quotas(nb_masters, 0);
+	for (MasterId m=0; m<nb_masters; m++) {
+		if (m != master_id && (m > master_id) == upwards && nb_agents_by_master[m] < max_load) {
+			// The margin is divided among the masters which may send to m in this
+			// round (below m upwards, above m downwards), the remainder going to
+			// the first ones, so that the arrivals never exceed it
+			size_t margin = max_load - nb_agents_by_master[m];
+			size_t senders = upwards ? m : nb_masters - 1 - m;
+			size_t rank = upwards ? master_id : master_id - m - 1;
+			quotas[m] = margin / senders + (rank < margin % senders ? 1 : 0);
+		}
+	}
+	size_t departures = 0;
+	if (nb_agents_by_master[master_id] > min_load) {
+		departures = nb_agents_by_master[master_id] - min_load;
+	}
+
+	// Candidates: (gain, agent, destination)
+	std::vector<std::tuple<uint64_t, AgentGlobalId, MasterId>> candidates;
+	for (auto &traffic : traffics) {
+		uint64_t total = traffic.second.local;
+		MasterId best_master = master_id;
+		uint64_t best_traffic = 0;
+		for (auto &remote : traffic.second.remote) {
+			total += remote.second;
+			if (remote.second > best_traffic || (remote.second == best_traffic && remote.first < best_master)) {
+				best_master = remote.first;
+				best_traffic = remote.second;
+			}
+		}
+		if (best_master == master_id || quotas[best_master] == 0 || total < MIGRATION_MIN_TRAFFIC ||
+				best_traffic <= MIGRATION_THRESHOLD*total || best_traffic <= traffic.second.local) {
+			continue;
+		}
+		candidates.emplace_back(best_traffic - traffic.second.local, traffic.first, best_master);
+	}
+	std::sort(candidates.begin(), candidates.end(),
+		[](const std::tuple<uint64_t, AgentGlobalId, MasterId> &a, const std::tuple<uint64_t, AgentGlobalId, MasterId> &b) {
+			return std::get<0>(a) > std::get<0>(b) || (std::get<0>(a) == std::get<0>(b) && std::get<1>(a) < std::get<1>(b));
+		});
+
+	for (auto &candidate : candidates) {
+		if (departures == 0) {
+			break;
+		}
+		MasterId destination = std::get<2>(candidate);
+		if (quotas[destination] == 0) {
+			continue;
+		}
+		quotas[destination]--;
+		departures--;
+		MetaEvolutionDescription description = MetaEvolutionDescription();
+		description.type = AgentEvolution::Migration;
+		description.agent_id = std::get<1>(candidate);
+		description.origin_id = master_id;
+		description.destination_id = destination;
+		description.private_overhead = 0;
+		migrations.push_back(description);
+	}
+}
+
+
+void ChooseReplicatedAgents(std::vector<AgentGlobalId> &read_agents,
+	MasterId nb_masters, std::vector<AgentGlobalId> &replicated_agents) {
+	double min_readers = std::max<double>(REPLICATION_MIN_READERS, REPLICATION_THRESHOLD*(nb_masters-1));
+	std::sort(read_agents.begin(), read_agents.end());
+	replicated_agents.clear();
+	size_t i = 0;
+	while (i < read_agents.size()) {
+		size_t j = i;
+		while (j < read_agents.size() && read_agents.at(j) == read_agents.at(i)) {
+			j++;
+		}
+		if (j-i >= min_readers) {
+			replicated_agents.push_back(read_agents.at(i));
+		}
+		i = j;
+	}
+}
+
+
+size_t ChooseNbAgentHandlers(std::map<size_t, double> &times, size_t current,
+	size_t max_nb_agent_handlers) {
+	if (current < max_nb_agent_handlers && times.find(current+1) == times.end()) {
+		return current+1;
+	}
+	if (current > 1 && times.find(current-1) == times.end()) {
+		return current-1;
+	}
+	size_t best = current;
+	for (auto &time : times) {
+		if (time.second < times.at(best)) {
+			best = time.first;
+		}
+	}
+	return best;
+}
+
+
+Time ChooseBatchSize(Time current, double elapsed) {
+	if (elapsed <= 0) {
+		return 2*current;
+	}
+	double next = current*RUN_BATCH_LATENCY/elapsed;
+	if (next < 1) {
+		return 1;
+	}
+	return std::min((Time)next, 2*current);
 }
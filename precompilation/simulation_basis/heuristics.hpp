@@ -10,10 +10,93 @@
 #define HEURISTICS_HPP_
 
 #include <vector>
+#include <map>
 
 #include "agent.hpp"
 
 
+/// Maximal relative deviation of the weight of a master from the average
+/// weight in GraphInitialMastersAssignement.
+const double MASTERS_IMBALANCE = 0.05;
+
+/// Maximal number of label propagation passes in
+/// GraphInitialMastersAssignement.
+const int MAX_LABEL_PROPAGATION_PASSES = 16;
+
+/// Maximal number of coordinates used by CurveInitialMastersAssignement.
+const size_t MAX_CURVE_DIMENSIONS = 3;
+
+/// Number of time steps between two migration rounds.
+const Time MIGRATION_PERIOD = 10;
+
+/// Minimal fraction of the traffic of an agent that must go to a single other
+/// master for the agent to migrate there.
+const double MIGRATION_THRESHOLD = 0.5;
+
+/// Minimal traffic of an agent since the last migration round for it to be
+/// considered for migration.
+const uint64_t MIGRATION_MIN_TRAFFIC = 4;
+
+/// Maximal relative deviation of the number of agents of a master from the
+/// average allowed by migrations.
+const double MIGRATION_IMBALANCE = 0.1;
+
+/// Number of time steps between two balancings of the agents over the agent
+/// handlers of a master.
+const Time HANDLERS_BALANCING_PERIOD = 10;
+
+/// Weight of the last measure in the moving average of the behavior cost of
+/// an agent, measured every HANDLERS_BALANCING_PERIOD time steps.
+const double BEHAVIOR_COST_SMOOTHING = 0.25;
+
+/// Maximal relative excess of cost of an agent handler over the average
+/// tolerated by RebalanceAgentHandlers.
+const double HANDLERS_IMBALANCE = 0.05;
+
+/// Number of time steps between two choices of the replicated agents.
+const Time REPLICATION_PERIOD = 10;
+
+/// Minimal fraction of the other masters that must read the public attributes
+/// of an agent for them to be replicated on all masters.
+const double REPLICATION_THRESHOLD = 0.5;
+
+/// Minimal number of other masters that must read the public attributes of an
+/// agent for them to be replicated on all masters.
+const size_t REPLICATION_MIN_READERS = 2;
+
+/// Number of time steps between two rebuilds of the graph of the masters
+/// exchanging interactions, dropping the neighbors which became silent.
+const Time NEIGHBORS_PERIOD = 50;
+
+/// Number of time steps during which a number of agent handlers is measured
+/// before the automatic mode chooses the next one.
+const Time AUTO_HANDLERS_PERIOD = 20;
+
+/// Number of choices of the automatic mode after which the measures are
+/// forgotten, so that the number of agent handlers adapts to the load of the
+/// node.
+const size_t AUTO_HANDLERS_EXPLORATION = 10;
+
+/// Target duration (in seconds) of a batch of periods in continuous run mode,
+/// which bounds the time taken by the user interface to answer a command.
+const double RUN_BATCH_LATENCY = 0.1;
+
+/// Number of last time steps whose statistics are kept by each master.
+const Time STATISTICS_WINDOW = 1000;
+
+/// Number of last time steps whose traffic with each master is kept by each
+/// master (the traffic of a time step takes O(number of masters * number of
+/// interaction types) memory).
+const Time TRAFFIC_WINDOW = 100;
+
+/// Number of last events kept for each thread of a master in tracing mode.
+const size_t TRACE_BUFFER_SIZE = 1 << 16;
+
+/// Number of bins of the histograms of the aggregate command if it is not
+/// given.
+const size_t AGGREGATE_HISTOGRAM_BINS = 10;
+
+
 /**
  * \fn void NaiveInitialMastersAssignement(std::vector<void*> &initial_agents,
  *                                         std::vector<MasterId> &assignment, MasterId nb_masters)
@@ -31,24 +114,113 @@ void NaiveInitialMastersAssignement(
 	std::vector<void*> &initial_agents,
 	std::vector<MasterId> &assignment, MasterId nb_masters);
 
+/**
+ * \fn void GraphInitialMastersAssignement(std::vector<void*> &initial_agents,
+ *                                         std::vector<AgentEdge> &edges,
+ *                                         std::vector<uint64_t> &weights,
+ *                                         std::vector<MasterId> &assignment,
+ *                                         std::vector<size_t> &order, MasterId nb_masters)
+ * \brief Allocates agents to masters so that the weight of the edges of the
+ *        interaction graph between different masters is small while the
+ *        total weight of the agents of each master is balanced.
+ * \param initial_agents Reference to the vector of pointers to AgentStructs
+ *        representing the initial agents.
+ * \param edges Reference to the edges of the interaction graph between the
+ *        initial agents.
+ * \param weights Reference to the vector of the weights of the initial agents
+ *        (in the order of initial_agents).
+ * \param assignment Reference to the vector which will contain the result of
+ *        the assignment.
+ * \param order Reference to the vector which will contain the indices of the
+ *        agents in breadth-first order.
+ * \param nb_masters Number of masters in the simulation.
+ * \details The agents are first ordered by a breadth-first traversal of the
+ * interaction graph and the order is cut in nb_masters ranges of equal weight;
+ * then label propagation passes move agents to the master they are the most
+ * connected to, as long as it decreases the cut and the weight of no master
+ * deviates from the average by more than MASTERS_IMBALANCE (or, above it, by
+ * more than the weight of the heaviest agent).
+ * \see AssignInitialMasters.
+ * \pre The size of assignment and weights must be the same as initial_agents.
+ */
+void GraphInitialMastersAssignement(
+	std::vector<void*> &initial_agents,
+	std::vector<AgentEdge> &edges, std::vector<uint64_t> &weights,
+	std::vector<MasterId> &assignment, std::vector<size_t> &order, MasterId nb_masters);
+
+/**
+ * \fn void CurveInitialMastersAssignement(std::vector<void*> &initial_agents,
+ *                                         std::vector<std::vector<double>> &coordinates,
+ *                                         std::vector<uint64_t> &weights,
+ *                                         std::vector<MasterId> &assignment,
+ *                                         std::vector<size_t> &order, MasterId nb_masters,
+ *                                         bool hilbert)
+ * \brief Allocates agents to masters so that agents close in space are on the
+ *        same master while the total weight of the agents of each master is
+ *        balanced.
+ * \param initial_agents Reference to the vector of pointers to AgentStructs
+ *        representing the initial agents.
+ * \param coordinates Reference to the vector of the coordinates of the
+ *        initial agents (empty for agents without position).
+ * \param weights Reference to the vector of the weights of the initial agents.
+ * \param assignment Reference to the vector which will contain the result of
+ *        the assignment.
+ * \param order Reference to the vector which will contain the indices of the
+ *        agents in the order of the curve.
+ * \param nb_masters Number of masters in the simulation.
+ * \param hilbert Whether the Hilbert curve is used (the Morton curve
+ *        otherwise).
+ * \details The coordinates are scaled to the bounding box of the agents and
+ * quantized on the grid of the curve (at most MAX_CURVE_DIMENSIONS of them are
+ * used); the agents are sorted by their index on the curve, and the order is
+ * cut in nb_masters ranges of equal weight. Agents without coordinates are put
+ * at the end of the order.
+ * \see AssignInitialMasters.
+ * \pre The size of assignment, coordinates and weights must be the same as
+ *      initial_agents.
+ */
+void CurveInitialMastersAssignement(
+	std::vector<void*> &initial_agents,
+	std::vector<std::vector<double>> &coordinates, std::vector<uint64_t> &weights,
+	std::vector<MasterId> &assignment, std::vector<size_t> &order, MasterId nb_masters,
+	bool hilbert);
+
 /**
  * \fn void AssignInitialMasters(std::vector<void*> &initial_agents,
- *                               std::vector<MasterId> &assignment, MasterId nb_masters)
+ *                               std::vector<AgentEdge> &edges,
+ *                               std::vector<uint64_t> &weights,
+ *                               std::vector<std::vector<double>> &coordinates,
+ *                               PlacementHeuristic heuristic,
+ *                               std::vector<MasterId> &assignment,
+ *                               std::vector<size_t> &order, MasterId nb_masters)
  * \brief Assigns the initial agents to their initial masters. May be able to
  *        choose the best heuristic for this choice.
  * \param initial_agents Reference to the vector of pointers to AgentStructs
  *        representing the initial agents.
+ * \param edges Reference to the edges of the interaction graph between the
+ *        initial agents (possibly empty).
+ * \param weights Reference to the vector of the weights of the initial agents
+ *        (in the order of initial_agents).
+ * \param coordinates Reference to the vector of the coordinates of the
+ *        initial agents (used by the space-filling curve heuristics).
+ * \param heuristic Heuristic chosen in the instance file.
  * \param assignment Reference to the vector which will contain the result of
  *        the assignment.
+ * \param order Reference to the vector which will contain the order in which
+ *        the agents should be sent, agents close in this order being close in
+ *        the simulation.
  * \param nb_masters Number of masters in the simulation.
  * \details Fills assignment such that agent initial_agents[i] will be given to
- * master assignment[i] and nb_to_send[j] contains the number of agents which
- * will be given to master j.
- * \pre The size of assignment must be the same as initial_agents.
+ * master assignment[i]. With PlacementHeuristic::Automatic, the graph
+ * heuristic is used if an interaction graph or non uniform weights are given,
+ * the naive one otherwise.
+ * \pre The size of assignment and weights must be the same as initial_agents.
  */
 void AssignInitialMasters(
 	std::vector<void*> &initial_agents,
-	std::vector<MasterId> &assignment, MasterId nb_masters);
+	std::vector<AgentEdge> &edges, std::vector<uint64_t> &weights,
+	std::vector<std::vector<double>> &coordinates, PlacementHeuristic heuristic,
+	std::vector<MasterId> &assignment, std::vector<size_t> &order, MasterId nb_masters);
 
 /**
  * \pre void NaiveInitialAgentHandlersAssignement(
@@ -68,6 +240,27 @@ void NaiveInitialAgentHandlersAssignement(
 	utils::fixed_size_multibuffer<AgentStruct> &initial_agents,
 	std::vector<size_t> &assignment, size_t nb_agent_handlers);
 
+/**
+ * \fn void ContiguousInitialAgentHandlersAssignement(
+ *               utils::fixed_size_multibuffer<AgentStruct> &initial_agents,
+ *               std::vector<size_t> &assignment, size_t nb_agent_handlers)
+ * \brief Allocates agents to agent handlers by cutting them, in the order in
+ *        which they were received, in ranges of the same amount of agents.
+ * \param initial_agents Reference to the fixed_size_multibuffer containing the
+ *        AgentStructs representing the initial agents.
+ * \param assignment Reference to the vector which will contain the result of
+ *        the assignment.
+ * \param nb_agent_handlers Number of agent handlers on the current master.
+ * \details Since master 0 sends the agents in the order given by
+ * AssignInitialMasters, agents close in the simulation are given to the same
+ * agent handler.
+ * \see Used in AssignInitialAgentHandlers.
+ * \pre The size of assignment must be the same as initial_agents.
+ */
+void ContiguousInitialAgentHandlersAssignement(
+	utils::fixed_size_multibuffer<AgentStruct> &initial_agents,
+	std::vector<size_t> &assignment, size_t nb_agent_handlers);
+
 /**
  * \fn void AssignInitialAgentHandlers(
  *              utils::fixed_size_multibuffer<AgentStruct> &initial_agents,
@@ -86,8 +279,100 @@ void AssignInitialAgentHandlers(
 	std::vector<size_t> &assignment, size_t nb_agent_handlers);
 
 /**
- * Fills MetaEvolutionDescriptions with all the migrations needed, using a given heuristic
+ * \fn void RebalanceAgentHandlers(std::vector<double> &costs,
+ *                                 std::vector<size_t> &assignment, size_t nb_agent_handlers)
+ * \brief Moves agents between the agent handlers of a master so that their
+ *        total behavior costs are balanced.
+ * \param costs Reference to the vector of the behavior costs of the agents.
+ * \param assignment Reference to the vector of the agent handlers of the
+ *        agents, modified in place.
+ * \param nb_agent_handlers Number of agent handlers on the current master.
+ * \details While the most loaded agent handler exceeds the average by more
+ * than HANDLERS_IMBALANCE, moves from it to the least loaded one the agent
+ * whose cost is the closest to half of their difference. Agents stay where
+ * they are otherwise, so that few agents change of agent handler.
+ * \pre The size of assignment must be the same as costs.
+ */
+void RebalanceAgentHandlers(std::vector<double> &costs,
+	std::vector<size_t> &assignment, size_t nb_agent_handlers);
+
+/**
+ * \fn void MigrateAgents(MasterId master_id, Time round,
+ *                        std::vector<std::pair<AgentGlobalId, TrafficCounters>> &traffics,
+ *                        std::vector<size_t> &nb_agents_by_master,
+ *                        std::vector<MetaEvolutionDescription> &migrations)
+ * \brief Chooses the agents of a master that should migrate to the master they
+ *        communicate the most with.
+ * \param master_id Identifier of the master holding the agents.
+ * \param round Number of the migration round.
+ * \param traffics Reference to the vector of the (sendable) agents of the
+ *        master with their traffic since the last migration round.
+ * \param nb_agents_by_master Reference to the vector of the number of agents
+ *        held by each master.
+ * \param migrations Reference to the vector to which the descriptions of the
+ *        chosen migrations are appended.
+ * \details An agent is a candidate if more than MIGRATION_THRESHOLD of its
+ * traffic goes to a single other master, and candidates with the largest gain
+ * are moved first. Each master only computes its own departures, so the number
+ * of arrivals on a master is bounded by dividing its margin below the
+ * MIGRATION_IMBALANCE bound among the masters allowed to send to it in this
+ * round, the remainder going to those of lowest identifiers. To avoid two agents
+ * communicating with each other swapping their masters, migrations only go
+ * towards higher identifiers on even rounds and lower identifiers on odd ones.
+ */
+void MigrateAgents(MasterId master_id, Time round,
+	std::vector<std::pair<AgentGlobalId, TrafficCounters>> &traffics,
+	std::vector<size_t> &nb_agents_by_master,
+	std::vector<MetaEvolutionDescription> &migrations);
+
+/**
+ * \fn void ChooseReplicatedAgents(std::vector<AgentGlobalId> &read_agents,
+ *                                 MasterId nb_masters,
+ *                                 std::vector<AgentGlobalId> &replicated_agents)
+ * \brief Chooses the agents whose public attributes are read by so many masters
+ *        that they should be sent to all masters at each time step.
+ * \param read_agents Reference to the concatenation, for all other masters,
+ *        of the agents held by this master that they read since the last
+ *        choice (each agent at most once per master).
+ * \param nb_masters Number of masters in the simulation.
+ * \param replicated_agents Reference to the vector filled with the chosen
+ *        agents, in increasing order.
+ * \details An agent is replicated if it is read by at least
+ * REPLICATION_MIN_READERS masters and REPLICATION_THRESHOLD of the masters
+ * other than its own.
+ */
+void ChooseReplicatedAgents(std::vector<AgentGlobalId> &read_agents,
+	MasterId nb_masters, std::vector<AgentGlobalId> &replicated_agents);
+
+/**
+ * \fn size_t ChooseNbAgentHandlers(std::map<size_t, double> &times, size_t current,
+ *                                  size_t max_nb_agent_handlers)
+ * \brief Chooses the number of agent handlers of a master to try next in the
+ *        automatic mode.
+ * \param times Reference to the map of the measured time of a step for each
+ *        number of agent handlers already tried.
+ * \param current Current number of agent handlers.
+ * \param max_nb_agent_handlers Maximal number of agent handlers.
+ * \return The number of agent handlers to use for the next period.
+ * \details Hill climbing: the neighbors of current which were not measured are
+ * tried first (more agent handlers before less), and the fastest number
+ * measured is kept once both are known.
+ * \pre times must contain current.
+ */
+size_t ChooseNbAgentHandlers(std::map<size_t, double> &times, size_t current,
+	size_t max_nb_agent_handlers);
+
+/**
+ * \fn Time ChooseBatchSize(Time current, double elapsed)
+ * \brief Chooses the number of periods of the next batch run between two
+ *        checks for user commands in continuous run mode.
+ * \param current Number of periods of the last batch.
+ * \param elapsed Duration (in seconds) of the last batch.
+ * \return The number of periods of the next batch, at least 1.
+ * \details The batch is scaled so that it lasts RUN_BATCH_LATENCY, but at
+ * most doubles from one batch to the next so that a sudden slowdown of the
+ * time steps does not make the user interface unresponsive.
  */
-void MigrateAgents();
+Time ChooseBatchSize(Time current, double elapsed);
 
 #endif
@@ -1,4 +1,6 @@
 #include <iostream>
+#include <string>
+#include <vector>
 #include <mpi.h>
 
 #include "user_interface.hpp"
@@ -6,16 +8,31 @@
 
 int main(int argc, char* argv[]) {
 	int provided;
-	// MPI is told to handle threads
-	MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+	// Only the main thread calls MPI, the agent handlers submit their
+	// communications to it
+	MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+	if (provided < MPI_THREAD_FUNNELED) {
+		std::cerr << "The MPI implementation does not support MPI_THREAD_FUNNELED, "
+		          << "which is required by the simulation." << std::endl;
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	}
 	
-	if (argc != 2) {
-		std::cerr << "Usage: " << argv[0] << " <interface_token>\n";
+	int status = 0;
+	if (argc == 3 && std::string(argv[1]) == "--script") {
+		// Headless mode, the commands are read from a file
+		status = InitHeadlessInterface(argv[2], {});
+	} else if (argc >= 2 && std::string(argv[1]) == "--commands") {
+		// Headless mode, each argument is a command
+		status = InitHeadlessInterface("", std::vector<std::string>(argv + 2, argv + argc));
+	} else if (argc == 2) {
+		InitUserInterface(std::string(argv[1]));
+	} else {
+		std::cerr << "Usage: " << argv[0] << " <interface_token>\n"
+		          << "       " << argv[0] << " --script <file>\n"
+		          << "       " << argv[0] << " --commands <command>...\n";
 		exit(1);
 	}
 
-	InitUserInterface(std::string(argv[1]));
-
 	MPI_Finalize();
-	return 0;
+	return status;
 }
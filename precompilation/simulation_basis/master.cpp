@@ -7,10 +7,13 @@
 #include <fstream>
 #include <vector>
 #include <algorithm>
+#include <numeric>
 #include <unordered_set>
 #include <thread>
 #include <ctime>
 #include <cstdlib>
+#include <cstring>
+#include <chrono>
 #include <mpi.h>
 
 #include "types.hpp"
@@ -28,15 +31,30 @@
 // MPI Type of this structure
 MPI_Datatype MetaEvolutionDescriptionMPIDatatype;
 
+// Number of reads of public attributes made by the current thread during the
+// running phase of the agent handlers, summed by RunAgentHandlers so that the
+// reads do not share a counter between threads
+thread_local uint64_t thread_public_reads = 0;
 
-Master::Master (MasterId id, MasterId nb_masters, int nb_threads, std::vector<void*> &initial_agents) :
 
-	step_{0}, order_{Order::IDLE}, period_{1}, id_{id}, nb_masters_{nb_masters}
+Master::Master (MasterId id, MasterId nb_masters, int nb_threads, std::vector<void*> &initial_agents,
+	const PlacementDescription &placement) :
+
+	step_{0}, order_{Order::IDLE}, period_{1}, id_{id}, nb_masters_{nb_masters},
+	auto_agent_handlers_{false}, agent_handlers_time_{0},
+	agent_handlers_measured_steps_{0}, auto_agent_handlers_rounds_{0}
 
 {
 	// Randomness initialization
 	srand(time(NULL) + id_);
 
+	// Statistics initialization
+	statistics_.resize(STATISTICS_WINDOW);
+	attributes_profiling_ = false;
+	attributes_profile_steps_ = 0;
+	tracing_ = false;
+	pending_probes_step_ = 0;
+
 	// Initialization of the parameters of the model by the precompilation step
 	nb_types_ = NbAgentTypes();
 	nb_interactions_ = NbInteractionTypes();
@@ -54,6 +72,15 @@ Master::Master (MasterId id, MasterId nb_masters, int nb_threads, std::vector<vo
 
 	CreateAgentsNamesRelation(agent_type_to_string_, string_to_agent_type_);
 	CreateAttributesNamesRelation(attribute_to_string_, string_to_attribute_);
+	CreateInteractionsNames(interaction_type_to_string_);
+	traffic_.assign(TRAFFIC_WINDOW, std::vector<double>(TrafficOffset(nb_masters_), 0.));
+	step_traffic_.assign(TrafficOffset(nb_masters_), 0.);
+	max_nb_attributes_ = 0;
+	for (auto &attribute : attribute_to_string_) {
+		max_nb_attributes_ = std::max(max_nb_attributes_, attribute.first.second + 1);
+	}
+	attributes_accesses_ = std::vector<std::atomic<uint64_t>>(
+		AttributeAccessOffset(nb_types_ + 1, 0, 0));
 
 	// TODO: Uncomment once precompilation handled constant
 	// GenerateConstants(constants_);
@@ -73,12 +100,38 @@ Master::Master (MasterId id, MasterId nb_masters, int nb_threads, std::vector<vo
 	// Initialization of the master communicator
 	MPI_Comm_split(MPI_COMM_WORLD, 0, id_, &MasterComm_);
 
+	// Initialization of the communicator of the masters sharing memory with
+	// this one, and of the holders of the critical windows
+	MPI_Comm_split_type(MasterComm_, MPI_COMM_TYPE_SHARED, id_, MPI_INFO_NULL, &NodeComm_);
+	int node_size, node_rank;
+	MPI_Comm_size(NodeComm_, &node_size);
+	MPI_Comm_rank(NodeComm_, &node_rank);
+	node_masters_.resize(node_size);
+	MPI_Allgather(&id_, 1, MPI_INT, node_masters_.data(), 1, MPI_INT, NodeComm_);
+	std::vector<int> holders(nb_masters_);
+	int holder = (node_rank == 0);
+	MPI_Allgather(&holder, 1, MPI_INT, holders.data(), 1, MPI_INT, MasterComm_);
+	for (MasterId m=0; m<nb_masters_; m++) {
+		if (holders.at(m)) {
+			critical_holders_.push_back(m);
+		}
+	}
+	colocated_public_windows_.assign(nb_masters_, nullptr);
+	NeighborsComm_ = MPI_COMM_NULL;
+	is_neighbor_.assign(nb_masters_, false);
+
 	// Receive and adds agents
-	InitializeAgents(initial_agents);
+	InitializeAgents(initial_agents, placement);
 
 }
 
 Master::~Master() {
+	// The last background export must be written
+	WaitExport();
+
+	// The buffered records of the probes are written
+	FlushProbes();
+
 	// Freeing the constants
 	for (auto &c : constants_) {
 		free(c.second);
@@ -88,9 +141,13 @@ Master::~Master() {
 	int is_finalized;
 	MPI_Finalized(&is_finalized);
 	if (!is_finalized) {
-		MPI_Win_free(&public_window_);
-		MPI_Win_free(&critical_window_);
+		FreeWindow(node_public_window_, public_window_);
+		FreeWindow(node_critical_window_, critical_window_);
 		MPI_Type_free(&MetaEvolutionDescriptionMPIDatatype);
+		if (NeighborsComm_ != MPI_COMM_NULL) {
+			MPI_Comm_free(&NeighborsComm_);
+		}
+		MPI_Comm_free(&NodeComm_);
 		MPI_Comm_free(&MasterComm_);
 	}
 }
@@ -133,25 +190,39 @@ void* Master::GetConstant(std::string constant) {
 }
 
 
-void* Master::GetAttribute(Attribute attr, AgentId recipient_id, AgentType recipient_type) {
+AgentId Master::FreshAgentId(AgentType type) {
+	return maximal_ids_.at(type) + id_ + nb_masters_*fresh_ids_.at(type)++;
+}
+
+
+void* Master::GetAttribute(Attribute attr, AgentId recipient_id, AgentType recipient_type, Agent* reader) {
 	AgentGlobalId id = LocalToGlobalId(recipient_id, recipient_type);
 	if (!DoesAgentExist(recipient_id, recipient_type)) {
 		throw AgentNotFound(recipient_id, agent_type_to_string_.at(recipient_type));
 	} else if (IsCritical(attr, recipient_type)) {
+		if (attributes_profiling_) {
+			CountAttributeAccess(reader, id, attr, AttributeAccess::CRITICAL);
+		}
 		return GetCriticalAttribute(attr, id);
 	} else {
-		return GetPublicAttribute(attr, id);
+		return GetPublicAttribute(attr, id, reader);
 	}
 }
 
 
 void Master::UpdateCriticalAttribute(Attribute attr, AgentId agent_id, AgentType agent_type, void* location) {
-	AgentType type = GlobalToLocalType(agent_id);
-	auto p = std::make_pair(type, attr);
-	size_t target_disp = critical_agents_offsets_.at(agent_id) + critical_attributes_offsets_.at(p);
-	MPI_Datatype attribute_type = attributes_MPI_types_.at(p);
-	for (MasterId id=0; id<nb_masters_; id++) {
-		MPI_Put(location, 1, attribute_type, id, target_disp, 1, attribute_type, critical_window_);
+	auto p = std::make_pair(agent_type, attr);
+	size_t target_disp = critical_agents_offsets_.at(LocalToGlobalId(agent_id, agent_type))
+		+ critical_attributes_offsets_.at(p);
+	RmaRequest request;
+	request.get = false;
+	request.location = location;
+	request.size = attributes_sizes_.at(p);
+	request.datatype = attributes_MPI_types_.at(p);
+	request.target_disp = target_disp;
+	for (MasterId id : critical_holders_) {
+		request.target = id;
+		rma_requests_.push(request);
 	}
 }
 
@@ -161,6 +232,10 @@ void Master::PushInteraction(std::unique_ptr<Interaction> &&inter) {
 	AgentGlobalId recipient_id = LocalToGlobalId(inter->recipient_id_, inter->recipient_type_);
 	if (DoesAgentExist(inter->recipient_id_, inter->recipient_type_)) {
 		MasterId recipient_master = masters_.at(recipient_id);
+		auto sender = agents_.find(LocalToGlobalId(inter->sender_id_, inter->sender_type_));
+		if (sender != agents_.end()) {
+			CountTraffic(sender->second, recipient_master);
+		}
 		interactions_to_send_.at(recipient_master*nb_interactions_+type).push_back(std::move(inter));
 	} else {
 		std::cerr << "Warning: Agent " << inter->sender_id_ << " of type " << agent_type_to_string_.at(inter->sender_type_)
@@ -176,11 +251,30 @@ void Master::RunSimulation() {
 	// masters
 	if (id_ == 0) {
 		order_ = Order::RUN_SIMULATION;
-		MPI_Bcast(&order_, 1, MPI_INT, 0, MasterComm_);
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
 	}
 	for (Time t=0; t<period_; t++) {
 		RunTimeStep();
 	}
+	CompleteProbes();
+	FlushProbes();
+}
+
+
+void Master::RunBatch(Time nb_periods) {
+	if (id_ == 0) {
+		// This method is a control method, so sends orders from master 0 to other
+		// masters
+		order_ = Order::RUN_BATCH;
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
+	}
+	// Receives the number of periods from master 0
+	MPI_Bcast(&nb_periods, 1, MPI_UINT64_T, 0, MasterComm_);
+	for (Time t=0; t<nb_periods*period_; t++) {
+		RunTimeStep();
+	}
+	CompleteProbes();
+	FlushProbes();
 }
 
 
@@ -189,7 +283,7 @@ void Master::ChangePeriod(Time new_period) {
 		// This method is a control method, so sends orders from master 0 to other
 		// masters
 		order_ = Order::CHANGE_PERIOD;
-		MPI_Bcast(&order_, 1, MPI_INT, 0, MasterComm_);
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
 		// Changes the time period
 		period_ = new_period;
 	}
@@ -198,15 +292,93 @@ void Master::ChangePeriod(Time new_period) {
 }
 
 
-// TODO
-void Master::AddUserAgents(std::vector<void*> &new_agents) {
+ubjson::Value Master::AddUserAgents(std::vector<void*> &new_agents) {
 	// This method is a control method, so sends orders from master 0 to other
 	// masters
 	if (id_ == 0) {
 		order_ = Order::ADD_AGENTS;
-		MPI_Bcast(&order_, 1, MPI_INT, 0, MasterComm_);
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
+	}
+
+	// Master 0 sends each structure to the master holding the fewest agents,
+	// in a slot of max_agent_size_ bytes
+	std::vector<int> sizes;
+	std::vector<int> displs;
+	std::vector<char> structures;
+	if (id_ == 0) {
+		std::unordered_map<AgentType, size_t> structs_sizes = AgentStructsSizes();
+		std::vector<size_t> loads = nb_agents_by_master_;
+		std::vector<std::vector<void*>> by_master(nb_masters_);
+		for (void* structure : new_agents) {
+			AgentType type = static_cast<AgentStruct*>(structure)->type;
+			MasterId destination = 0;
+			if (IsAgentSendable(type)) {
+				destination = std::min_element(loads.begin(), loads.end()) - loads.begin();
+			}
+			loads.at(destination)++;
+			by_master.at(destination).push_back(structure);
+		}
+		sizes.resize(nb_masters_);
+		displs.resize(nb_masters_, 0);
+		structures.resize(new_agents.size()*max_agent_size_);
+		size_t k = 0;
+		for (MasterId m=0; m<nb_masters_; m++) {
+			sizes.at(m) = by_master.at(m).size()*max_agent_size_;
+			displs.at(m) = k*max_agent_size_;
+			for (void* structure : by_master.at(m)) {
+				memcpy(structures.data() + k*max_agent_size_, structure,
+					structs_sizes.at(static_cast<AgentStruct*>(structure)->type));
+				k++;
+			}
+		}
+	}
+	int local_size;
+	MPI_Scatter(sizes.data(), 1, MPI_INT, &local_size, 1, MPI_INT, 0, MasterComm_);
+	std::vector<char> local_structures(local_size);
+	MPI_Scatterv(structures.data(), sizes.data(), displs.data(), MPI_BYTE, local_structures.data(),
+		local_size, MPI_BYTE, 0, MasterComm_);
+
+	// The new agents are staged as births in the least loaded agent handlers,
+	// so that the next MetaEvolution adds them to all masters
+	std::vector<AgentGlobalId> local_ids;
+	for (size_t k=0; k<local_structures.size()/max_agent_size_; k++) {
+		std::unique_ptr<Agent> agent = Agent::FromStruct(local_structures.data() + k*max_agent_size_, id_, *this);
+		auto load = [](AgentHandler &handler) { return handler.agents.size() + handler.born_agents.size(); };
+		AgentHandler* least_loaded = &agent_handlers_.front();
+		for (auto &agent_handler : agent_handlers_) {
+			if (load(agent_handler) < load(*least_loaded)) {
+				least_loaded = &agent_handler;
+			}
+		}
+		agent->id_ = least_loaded->NewAgentId(agent->type_);
+		local_ids.push_back(LocalToGlobalId(agent->id_, agent->type_));
+		least_loaded->born_agents.push_back(std::move(agent));
+	}
+
+	// Gathering the identifiers of the new agents on master 0
+	int local_count = local_ids.size();
+	std::vector<int> counts;
+	if (id_ == 0) {
+		counts.resize(nb_masters_);
+	}
+	MPI_Gather(&local_count, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, MasterComm_);
+	std::vector<AgentGlobalId> ids;
+	if (id_ == 0) {
+		displs.assign(nb_masters_, 0);
+		for (MasterId m=1; m<nb_masters_; m++) {
+			displs.at(m) = displs.at(m-1) + counts.at(m-1);
+		}
+		ids.resize(displs.back() + counts.back());
 	}
-	// TODO
+	MPI_Gatherv(local_ids.data(), local_count, MPI_UINT64_T, ids.data(), counts.data(), displs.data(),
+		MPI_UINT64_T, 0, MasterComm_);
+
+	ubjson::Value result;
+	for (AgentGlobalId global_id : ids) {
+		result[agent_type_to_string_.at(GlobalToLocalType(global_id))].push_back(
+			(unsigned long long)GlobalToLocalId(global_id));
+	}
+	return result;
 }
 
 
@@ -232,7 +404,7 @@ void Master::ModifyAttribute(Attribute attr, AgentId agent_id, AgentType agent_t
 		// This method is a control method, so sends orders from master 0 to
 		// other masters
 		order_ = Order::MODIFY_ATTRIBUTE;
-		MPI_Bcast(&order_, 1, MPI_INT, 0, MasterComm_);
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
 	}
 	// Sends the info to the other masters
 	MPI_Bcast(&recipient_global_id, 1, MPI_UINT64_T, 0, MasterComm_);
@@ -260,12 +432,386 @@ void Master::ModifyAttribute(Attribute attr, AgentId agent_id, AgentType agent_t
 }
 
 
+size_t Master::ModifyAttributes(const std::vector<AttributeModification> &modifications) {
+	// Modification sent to the masters, the value being copied in its first
+	// bytes
+	struct ModificationRecord {
+		AgentGlobalId global_id;
+		Attribute attribute;
+		uint64_t value;
+	};
+	std::vector<ModificationRecord> records;
+	if (id_ == 0) {
+		for (auto &modification : modifications) {
+			auto p = std::make_pair(modification.agent_type, modification.attribute);
+			auto mpi_type = attributes_MPI_types_.find(p);
+			AttributeParser parse = mpi_type == attributes_MPI_types_.end() ? nullptr : GetAttributeParser(mpi_type->second);
+			if (modification.agent_type >= nb_types_ || parse == nullptr || attributes_sizes_.at(p) > sizeof(uint64_t)) {
+				std::cerr << "The attribute " << modification.attribute << " of the agent type " << modification.agent_type
+				          << " does not exist or is not numerical." << std::endl;
+				continue;
+			}
+			if (!DoesAgentExist(modification.agent_id, modification.agent_type)) {
+				std::cerr << "The agent " << modification.agent_id << " of type " << agent_type_to_string_.at(modification.agent_type)
+				          << " does not exist." << std::endl;
+				continue;
+			}
+			ModificationRecord record = {LocalToGlobalId(modification.agent_id, modification.agent_type),
+				modification.attribute, 0};
+			if (!parse(modification.value, &record.value)) {
+				std::cerr << "Invalid value " << modification.value << " for the attribute "
+				          << attribute_to_string_.at(p) << "." << std::endl;
+				continue;
+			}
+			records.push_back(record);
+		}
+		if (records.empty()) {
+			return 0;
+		}
+		// This method is a control method, so sends orders from master 0 to
+		// other masters
+		order_ = Order::MODIFY_ATTRIBUTES;
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
+	}
+	uint64_t count = records.size();
+	MPI_Bcast(&count, 1, MPI_UINT64_T, 0, MasterComm_);
+	records.resize(count);
+	MPI_Bcast(records.data(), count*sizeof(ModificationRecord), MPI_BYTE, 0, MasterComm_);
+
+	// Each master modifies its own agents
+	for (auto &record : records) {
+		if (masters_.at(record.global_id) == id_) {
+			memcpy(agents_.at(record.global_id)->GetPointerToAttribute(record.attribute), &record.value,
+				attributes_sizes_.at(std::make_pair(GlobalToLocalType(record.global_id), record.attribute)));
+		}
+	}
+	return count;
+}
+
+
+ubjson::Value Master::GetAgentJsonNode(AgentId agent_id, AgentType agent_type) {
+	if (id_ == 0) {
+		if (agent_type >= nb_types_) {
+			std::cerr << "The agent type " << agent_type << " does not exist." << std::endl;
+			return ubjson::Value();
+		}
+		if (!DoesAgentExist(agent_id, agent_type)) {
+			std::cerr << "The agent " << agent_id << " of type " << agent_type_to_string_.at(agent_type)
+			          << " does not exist." << std::endl;
+			return ubjson::Value();
+		}
+		// This method is a control method, so sends orders from master 0 to other
+		// masters
+		order_ = Order::GET_AGENT;
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
+	}
+	AgentGlobalId global_id = LocalToGlobalId(agent_id, agent_type);
+	MPI_Bcast(&global_id, 1, MPI_UINT64_T, 0, MasterComm_);
+	MasterId owner = masters_.at(global_id);
+	if (owner == 0) {
+		return id_ == 0 ? agents_.at(global_id)->GetJsonNode() : ubjson::Value();
+	}
+
+	// Only the master of the agent sends it, with tag 2
+	if (id_ == owner) {
+		std::ostringstream stream;
+		ubjson::StreamWriter<std::ostringstream> writer(stream);
+		writer.writeValue(agents_.at(global_id)->GetJsonNode());
+		std::string data = stream.str();
+		MPI_Send(data.data(), data.size(), MPI_CHAR, 0, 2, MasterComm_);
+	} else if (id_ == 0) {
+		MPI_Status status;
+		int size;
+		MPI_Probe(owner, 2, MasterComm_, &status);
+		MPI_Get_count(&status, MPI_CHAR, &size);
+		std::string data(size, '\0');
+		MPI_Recv(&data[0], size, MPI_CHAR, owner, 2, MasterComm_, MPI_STATUS_IGNORE);
+		std::istringstream stream(data);
+		ubjson::StreamReader<std::istringstream> reader(stream);
+		return reader.getNextValue();
+	}
+	return ubjson::Value();
+}
+
+
+ubjson::Value Master::Aggregate(AgentType agent_type, Attribute attr, Aggregation op, size_t nb_bins) {
+	if (id_ == 0) {
+		auto mpi_type = attributes_MPI_types_.find(std::make_pair(agent_type, attr));
+		if (agent_type >= nb_types_ || mpi_type == attributes_MPI_types_.end()) {
+			std::cerr << "The attribute " << attr << " of the agent type " << agent_type << " does not exist." << std::endl;
+			return ubjson::Value();
+		}
+		if (GetAttributeReader(mpi_type->second) == nullptr) {
+			std::cerr << "The attribute " << attribute_to_string_.at(mpi_type->first) << " of the agent type "
+			          << agent_type_to_string_.at(agent_type) << " is not numerical." << std::endl;
+			return ubjson::Value();
+		}
+		// This method is a control method, so sends orders from master 0 to other
+		// masters
+		order_ = Order::AGGREGATE;
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
+	}
+	// Receives the parameters of the aggregation from master 0
+	uint64_t parameters[4] = {agent_type, attr, static_cast<uint64_t>(op), nb_bins};
+	MPI_Bcast(parameters, 4, MPI_UINT64_T, 0, MasterComm_);
+	agent_type = parameters[0];
+	attr = parameters[1];
+	op = static_cast<Aggregation>(parameters[2]);
+	nb_bins = std::max(parameters[3], (uint64_t)1);
+	AttributeReader read = GetAttributeReader(attributes_MPI_types_.at(std::make_pair(agent_type, attr)));
+
+	AttributeAggregate local = AggregateLocally(agent_type, attr, read, AttributeAggregate());
+	// The maximum is reduced as the minimum of its opposite, so that both
+	// bounds need a single reduction
+	double sums[2] = {local.count, local.sum};
+	double bounds[2] = {local.min, -local.max};
+	double global_sums[2];
+	double global_bounds[2];
+	std::vector<double> bins;
+	if (op == Aggregation::HISTOGRAM) {
+		// All masters need the range of the values to fill the same bins
+		MPI_Allreduce(bounds, global_bounds, 2, MPI_DOUBLE, MPI_MIN, MasterComm_);
+		AttributeAggregate initial;
+		initial.lower = global_bounds[0];
+		initial.upper = -global_bounds[1];
+		initial.histogram.assign(nb_bins, 0);
+		local = AggregateLocally(agent_type, attr, read, initial);
+		bins.resize(nb_bins);
+		MPI_Reduce(local.histogram.data(), bins.data(), nb_bins, MPI_DOUBLE, MPI_SUM, 0, MasterComm_);
+	} else {
+		MPI_Reduce(bounds, global_bounds, 2, MPI_DOUBLE, MPI_MIN, 0, MasterComm_);
+	}
+	MPI_Reduce(sums, global_sums, 2, MPI_DOUBLE, MPI_SUM, 0, MasterComm_);
+
+	ubjson::Value result;
+	if (id_ != 0) {
+		return result;
+	}
+	double count = global_sums[0];
+	result["type"] = agent_type_to_string_.at(agent_type);
+	result["attribute"] = attribute_to_string_.at(std::make_pair(agent_type, attr));
+	result["count"] = (unsigned long long)count;
+	// Without any agent, only the sum is defined
+	ubjson::Value min = count > 0 ? ubjson::Value(global_bounds[0]) : ubjson::Value();
+	ubjson::Value max = count > 0 ? ubjson::Value(-global_bounds[1]) : ubjson::Value();
+	switch (op) {
+		case Aggregation::SUM: {
+			result["sum"] = global_sums[1];
+			break;
+		}
+		case Aggregation::MEAN: {
+			result["mean"] = count > 0 ? ubjson::Value(global_sums[1]/count) : ubjson::Value();
+			break;
+		}
+		case Aggregation::MIN: {
+			result["min"] = min;
+			break;
+		}
+		case Aggregation::MAX: {
+			result["max"] = max;
+			break;
+		}
+		case Aggregation::HISTOGRAM: {
+			result["min"] = min;
+			result["max"] = max;
+			for (double bin : bins) {
+				result["bins"].push_back((unsigned long long)bin);
+			}
+			break;
+		}
+		default:
+			break;
+	}
+	return result;
+}
+
+
+AttributeAggregate Master::AggregateLocally(AgentType agent_type, Attribute attr, AttributeReader read,
+	const AttributeAggregate &initial)
+{
+	std::vector<AttributeAggregate> aggregates(agent_handlers_.size(), initial);
+	std::vector<std::thread> threads;
+	for (size_t i=0; i<agent_handlers_.size(); i++) {
+		threads.emplace_back([this, agent_type, attr, read, i, &aggregates]() {
+			agent_handlers_.at(i).AggregateAttribute(agent_type, attr, read, aggregates.at(i));
+		});
+	}
+	for (auto &thread : threads) {
+		thread.join();
+	}
+	AttributeAggregate total = initial;
+	for (auto &aggregate : aggregates) {
+		total += aggregate;
+	}
+	return total;
+}
+
+
+bool Master::AddProbe(AgentType agent_type, Attribute attr, Aggregation op, Time period, std::string file) {
+	if (id_ == 0) {
+		auto mpi_type = attributes_MPI_types_.find(std::make_pair(agent_type, attr));
+		if (agent_type >= nb_types_ || mpi_type == attributes_MPI_types_.end()
+			|| GetAttributeReader(mpi_type->second) == nullptr)
+		{
+			std::cerr << "The attribute " << attr << " of the agent type " << agent_type
+			          << " does not exist or is not numerical." << std::endl;
+			return false;
+		}
+		if (op == Aggregation::HISTOGRAM || period == 0) {
+			std::cerr << "A probe needs a period and cannot compute a histogram." << std::endl;
+			return false;
+		}
+		std::ofstream stream;
+		if (file != "-") {
+			stream.open(file, std::ios::binary | std::ios::trunc);
+			if (!stream) {
+				std::cerr << "Could not open the file " << file << " of the probe." << std::endl;
+				return false;
+			}
+			ProbeFileHeader header = ProbeFileHeader();
+			std::memcpy(header.magic, "ASSAPROB", sizeof(header.magic));
+			header.period = period;
+			std::strncpy(header.op, AGGREGATIONS_NAMES[static_cast<size_t>(op)], sizeof(header.op)-1);
+			std::strncpy(header.type, agent_type_to_string_.at(agent_type).c_str(), sizeof(header.type)-1);
+			std::strncpy(header.attribute, attribute_to_string_.at(std::make_pair(agent_type, attr)).c_str(),
+				sizeof(header.attribute)-1);
+			stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		}
+		probes_files_.push_back(std::move(stream));
+		probes_records_.emplace_back();
+		// This method is a control method, so sends orders from master 0 to other
+		// masters
+		order_ = Order::ADD_PROBE;
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
+	}
+	// Receives the probe from master 0
+	uint64_t parameters[4] = {agent_type, attr, static_cast<uint64_t>(op), period};
+	MPI_Bcast(parameters, 4, MPI_UINT64_T, 0, MasterComm_);
+	probes_.push_back(ProbeDescription{parameters[0], parameters[1],
+		static_cast<Aggregation>(parameters[2]), parameters[3]});
+	return true;
+}
+
+
+void Master::ClearProbes() {
+	if (id_ == 0) {
+		// This method is a control method, so sends orders from master 0 to other
+		// masters
+		order_ = Order::CLEAR_PROBES;
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
+	}
+	CompleteProbes();
+	FlushProbes();
+	probes_.clear();
+	probes_files_.clear();
+	probes_records_.clear();
+}
+
+
+ubjson::Value Master::TakeProbesRecords() {
+	ubjson::Value result;
+	for (size_t i=0; i<probes_.size(); i++) {
+		if (probes_files_.at(i).is_open()) {
+			continue;
+		}
+		ProbeDescription &probe = probes_.at(i);
+		ubjson::Value json;
+		json["type"] = agent_type_to_string_.at(probe.type);
+		json["attribute"] = attribute_to_string_.at(std::make_pair(probe.type, probe.attribute));
+		json["op"] = AGGREGATIONS_NAMES[static_cast<size_t>(probe.op)];
+		json["period"] = (unsigned long long)probe.period;
+		for (auto &record : probes_records_.at(i)) {
+			ubjson::Value pair;
+			pair.push_back((unsigned long long)record.first);
+			pair.push_back(record.second);
+			json["records"].push_back(std::move(pair));
+		}
+		probes_records_.at(i).clear();
+		result.push_back(std::move(json));
+	}
+	return result;
+}
+
+
+void Master::EvaluateProbes() {
+	CompleteProbes();
+	for (size_t i=0; i<probes_.size(); i++) {
+		if (step_%probes_.at(i).period == 0) {
+			pending_probes_.push_back(i);
+		}
+	}
+	if (pending_probes_.empty()) {
+		return;
+	}
+	pending_probes_step_ = step_;
+	size_t n = pending_probes_.size();
+	probes_sums_.resize(2*n);
+	probes_bounds_.resize(2*n);
+	probes_global_sums_.resize(2*n);
+	probes_global_bounds_.resize(2*n);
+	for (size_t k=0; k<n; k++) {
+		ProbeDescription &probe = probes_.at(pending_probes_.at(k));
+		AttributeReader read = GetAttributeReader(attributes_MPI_types_.at(std::make_pair(probe.type, probe.attribute)));
+		AttributeAggregate local = AggregateLocally(probe.type, probe.attribute, read, AttributeAggregate());
+		probes_sums_.at(2*k) = local.count;
+		probes_sums_.at(2*k+1) = local.sum;
+		probes_bounds_.at(2*k) = local.min;
+		probes_bounds_.at(2*k+1) = -local.max;
+	}
+	// The results are only needed by master 0 once the next probes are
+	// evaluated, so the reductions progress during the next time steps
+	MPI_Ireduce(probes_sums_.data(), probes_global_sums_.data(), 2*n, MPI_DOUBLE, MPI_SUM, 0,
+		MasterComm_, &probes_requests_[0]);
+	MPI_Ireduce(probes_bounds_.data(), probes_global_bounds_.data(), 2*n, MPI_DOUBLE, MPI_MIN, 0,
+		MasterComm_, &probes_requests_[1]);
+}
+
+
+void Master::CompleteProbes() {
+	if (pending_probes_.empty()) {
+		return;
+	}
+	MPI_Waitall(2, probes_requests_, MPI_STATUSES_IGNORE);
+	if (id_ == 0) {
+		for (size_t k=0; k<pending_probes_.size(); k++) {
+			double count = probes_global_sums_.at(2*k);
+			double value = std::numeric_limits<double>::quiet_NaN();
+			switch (probes_.at(pending_probes_.at(k)).op) {
+				case Aggregation::COUNT: value = count; break;
+				case Aggregation::SUM: value = probes_global_sums_.at(2*k+1); break;
+				case Aggregation::MEAN: if (count > 0) value = probes_global_sums_.at(2*k+1)/count; break;
+				case Aggregation::MIN: if (count > 0) value = probes_global_bounds_.at(2*k); break;
+				case Aggregation::MAX: if (count > 0) value = -probes_global_bounds_.at(2*k+1); break;
+				default: break;
+			}
+			std::ofstream &file = probes_files_.at(pending_probes_.at(k));
+			if (!file.is_open()) {
+				probes_records_.at(pending_probes_.at(k)).emplace_back(pending_probes_step_, value);
+				continue;
+			}
+			file.write(reinterpret_cast<const char*>(&pending_probes_step_), sizeof(Time));
+			file.write(reinterpret_cast<const char*>(&value), sizeof(double));
+		}
+	}
+	pending_probes_.clear();
+}
+
+
+void Master::FlushProbes() {
+	for (auto &file : probes_files_) {
+		if (file.is_open()) {
+			file.flush();
+		}
+	}
+}
+
+
 ubjson::Value Master::ExportSimulation() {
 	// This method is a control method, so sends orders from master 0 to other
 	// masters
 	if (id_ == 0) {
 		order_ = Order::EXPORT_SIMULATION;
-		MPI_Bcast(&order_, 1, MPI_INT, 0, MasterComm_);
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
 	}
 
 	ubjson::Value local_agents;
@@ -285,25 +831,29 @@ ubjson::Value Master::ExportSimulation() {
 	int local_data_size = local_data.size();
 	// First master 0 must know how much data it will receive
 	std::vector<int> sizes_to_receive;
+	std::vector<int> displs;
 	if (id_ == 0) {
 		sizes_to_receive.resize(nb_masters_);
 	}
 	MPI_Gather(&local_data_size, 1, MPI_INT, sizes_to_receive.data(), 1, MPI_INT, 0, MasterComm_);
-	// Storing the results in 'results'
-	std::vector<std::string> results;
+	// The data of all masters is received contiguously in 'all_data'
+	std::string all_data;
 	if (id_ == 0) {
-		for (int i=0; i<nb_masters_; i++) {
-			results.emplace_back(std::string(sizes_to_receive.at(i), '0'));
+		displs.resize(nb_masters_, 0);
+		for (int i=1; i<nb_masters_; i++) {
+			displs.at(i) = displs.at(i-1) + sizes_to_receive.at(i-1);
 		}
+		all_data.resize(displs.back() + sizes_to_receive.back());
 	}
-	std::vector<int> displs;
+	MPI_Gatherv((void*)local_data.data(), local_data_size, MPI_UNSIGNED_CHAR,
+		(void*)all_data.data(), sizes_to_receive.data(), displs.data(), MPI_UNSIGNED_CHAR, 0, MasterComm_);
+	// Storing the results in 'results'
+	std::vector<std::string> results;
 	if (id_ == 0) {
 		for (int i=0; i<nb_masters_; i++) {
-			displs.push_back(results.at(i).data()-(char*)results.data());
+			results.push_back(all_data.substr(displs.at(i), sizes_to_receive.at(i)));
 		}
 	}
-	MPI_Gatherv((void*)local_data.data(), local_data_size, MPI_UNSIGNED_CHAR,
-		(void*)results.data(), sizes_to_receive.data(), displs.data(), MPI_UNSIGNED_CHAR, 0, MasterComm_);
 
 	// Grouping the results
 	ubjson::Value agents;
@@ -324,83 +874,596 @@ ubjson::Value Master::ExportSimulation() {
 }
 
 
-void Master::KillSimulation() {
+ubjson::Value Master::GetStatistics(Time nb_steps) {
 	if (id_ == 0) {
-		order_ = Order::KILL_SIMULATION;
-		MPI_Bcast(&order_, 1, MPI_INT, 0, MasterComm_);
+		// This method is a control method, so sends orders from master 0 to other
+		// masters
+		order_ = Order::STATISTICS;
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
+	}
+	// Receives the number of time steps from master 0
+	MPI_Bcast(&nb_steps, 1, MPI_UINT64_T, 0, MasterComm_);
+	Time recorded = std::min(step_, STATISTICS_WINDOW);
+	if (nb_steps == 0 || nb_steps > recorded) {
+		nb_steps = recorded;
 	}
-}
 
+	StepStatistics local;
+	for (Time t=step_-nb_steps; t<step_; t++) {
+		local += statistics_.at(t%STATISTICS_WINDOW);
+	}
+	std::vector<StepStatistics> all;
+	if (id_ == 0) {
+		all.resize(nb_masters_);
+	}
+	MPI_Gather(&local, STEP_STATISTICS_SIZE, MPI_DOUBLE, all.data(), STEP_STATISTICS_SIZE, MPI_DOUBLE,
+		0, MasterComm_);
 
-void Master::WaitOrderFromRoot() {
-	if (id_ == 0)
-		return;
-	while (order_ != Order::KILL_SIMULATION) {
-		order_ = Order::IDLE;
-		// Waits for an order of master 0
-		MPI_Bcast(&order_, 1, MPI_INT, 0, MasterComm_);
-		switch (order_) {
-			case Order::RUN_SIMULATION: {
-				RunSimulation();
-				break;
-			}
-			case Order::CHANGE_PERIOD: {
-				ChangePeriod(0);
-				break;
-			}
-			case Order::ADD_AGENTS: {
-				// Meaningless vector used to be able to call the following method
-				std::vector<void*> artefact = {};
-				AddUserAgents(artefact);
-				break;
-			}
-			case Order::MODIFY_ATTRIBUTE: {
-				ModifyAttribute();
-				break;
-			}
-			case Order::EXPORT_SIMULATION: {
-				ExportSimulation();
-				break;
-			}
-			default:
-				continue;
+	ubjson::Value statistics;
+	if (id_ != 0) {
+		return statistics;
+	}
+	StepStatistics total;
+	for (auto &master_statistics : all) {
+		total += master_statistics;
+		statistics["masters"].push_back(StatisticsToJson(master_statistics, nb_steps));
+	}
+	// The time of the simulation is the one of the slowest master
+	for (size_t i=0; i<NB_PHASES; i++) {
+		total.phases[i] = 0;
+		for (auto &master_statistics : all) {
+			total.phases[i] = std::max(total.phases[i], master_statistics.phases[i]);
 		}
 	}
+	for (size_t i=0; i<NB_SYNC_POINTS; i++) {
+		total.synchronizations[i] = 0;
+		for (auto &master_statistics : all) {
+			total.synchronizations[i] = std::max(total.synchronizations[i], master_statistics.synchronizations[i]);
+		}
+	}
+	statistics["total"] = StatisticsToJson(total, nb_steps);
+	statistics["steps"] = (unsigned long long)nb_steps;
+	return statistics;
 }
 
 
-void Master::ConvertOutputToInput(std::string in, std::string out) {
-	std::ifstream file_in(in, std::ios::in);
-	ubjson::StreamReader<std::ifstream> reader(file_in);
-	ubjson::Value agents = reader.getNextValue();
-	file_in.close();
-
-	ubjson::Value agent_types;
-	for (auto &x : agent_type_to_string_) {
-		ubjson::Value agent_type;
-		agent_type["type"] = x.second;
-		agent_type["number"] = (int)agents["agents"][x.second].size();
-		agent_type["agents"] = agents["agents"][x.second];
-		agent_types.push_back(std::move(agent_type));
+ubjson::Value Master::GetPhaseTimings(Time nb_steps) {
+	if (id_ == 0) {
+		// This method is a control method, so sends orders from master 0 to other
+		// masters
+		order_ = Order::PHASE_TIMINGS;
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
+	}
+	// Receives the number of time steps from master 0
+	MPI_Bcast(&nb_steps, 1, MPI_UINT64_T, 0, MasterComm_);
+	Time recorded = std::min(step_, STATISTICS_WINDOW);
+	if (nb_steps == 0 || nb_steps > recorded) {
+		nb_steps = recorded;
 	}
 
-	ubjson::Value result;
-	result["agent_types"] = agent_types;
-	std::ofstream file_out(out, std::ios::out);
-	file_out << ubjson::to_ostream(result, ubjson::to_ostream::pretty) << std::endl;
-	file_in.close();
-
-}
-
-
-AgentGlobalId Master::LocalToGlobalId(AgentId id, AgentType type) {
-	return nb_types_*id + type;
+	// The timers are the phases followed by the synchronization points, and
+	// each one has NB_TIMER_VALUES values
+	const size_t NB_TIMERS = NB_PHASES + NB_SYNC_POINTS;
+	const size_t NB_TIMER_VALUES = 4;
+	const char* const values_names[NB_TIMER_VALUES] = {"p50", "p95", "max", "mean"};
+	// Local values, then their opposites so that a single MPI_MIN gives both
+	// the minimums and the maximums
+	std::vector<double> bounds(2*NB_TIMERS*NB_TIMER_VALUES, 0);
+	std::vector<double> samples(nb_steps);
+	for (size_t timer=0; timer<NB_TIMERS && nb_steps > 0; timer++) {
+		for (Time t=0; t<nb_steps; t++) {
+			const StepStatistics &statistics = statistics_.at((step_-nb_steps+t)%STATISTICS_WINDOW);
+			samples.at(t) = timer < NB_PHASES ? statistics.phases[timer]
+				: statistics.synchronizations[timer-NB_PHASES];
+		}
+		double* values = &bounds.at(timer*NB_TIMER_VALUES);
+		values[3] = std::accumulate(samples.begin(), samples.end(), 0.)/nb_steps;
+		// Nearest-rank percentiles, the partial sorts keeping the ranks below
+		// them in front
+		auto rank = [&](Time percent) { return samples.begin() + (percent*nb_steps + 99)/100 - 1; };
+		std::nth_element(samples.begin(), rank(95), samples.end());
+		values[1] = *rank(95);
+		values[2] = *std::max_element(rank(95), samples.end());
+		std::nth_element(samples.begin(), rank(50), rank(95));
+		values[0] = *rank(50);
+	}
+	std::vector<double> sums(bounds.begin(), bounds.begin() + NB_TIMERS*NB_TIMER_VALUES);
+	for (size_t i=0; i<NB_TIMERS*NB_TIMER_VALUES; i++) {
+		bounds.at(NB_TIMERS*NB_TIMER_VALUES + i) = -bounds.at(i);
+	}
+	std::vector<double> global_bounds(bounds.size());
+	std::vector<double> global_sums(sums.size());
+	MPI_Reduce(bounds.data(), global_bounds.data(), bounds.size(), MPI_DOUBLE, MPI_MIN, 0, MasterComm_);
+	MPI_Reduce(sums.data(), global_sums.data(), sums.size(), MPI_DOUBLE, MPI_SUM, 0, MasterComm_);
+
+	ubjson::Value timings;
+	if (id_ != 0) {
+		return timings;
+	}
+	for (size_t timer=0; timer<NB_TIMERS; timer++) {
+		const char* name = timer < NB_PHASES ? PHASES_NAMES[timer] : SYNC_POINTS_NAMES[timer-NB_PHASES];
+		for (size_t k=0; k<NB_TIMER_VALUES; k++) {
+			size_t i = timer*NB_TIMER_VALUES + k;
+			ubjson::Value &value = timings["timers"][name][values_names[k]];
+			value["min"] = global_bounds.at(i);
+			value["avg"] = global_sums.at(i)/nb_masters_;
+			value["max"] = -global_bounds.at(NB_TIMERS*NB_TIMER_VALUES + i);
+		}
+	}
+	timings["steps"] = (unsigned long long)nb_steps;
+	return timings;
 }
 
 
-AgentId Master::GlobalToLocalId(AgentGlobalId id) {
-	return id / nb_types_;
-}
+ubjson::Value Master::GetTrafficMatrix(Time nb_steps) {
+	if (id_ == 0) {
+		// This method is a control method, so sends orders from master 0 to other
+		// masters
+		order_ = Order::TRAFFIC_MATRIX;
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
+	}
+	// Receives the number of time steps from master 0
+	MPI_Bcast(&nb_steps, 1, MPI_UINT64_T, 0, MasterComm_);
+	Time recorded = std::min(step_, TRAFFIC_WINDOW);
+	if (nb_steps == 0 || nb_steps > recorded) {
+		nb_steps = recorded;
+	}
+
+	// Each master sends its row of the matrix to master 0
+	size_t row_size = TrafficOffset(nb_masters_);
+	std::vector<double> row(row_size, 0.);
+	for (Time t=step_-nb_steps; t<step_; t++) {
+		const std::vector<double> &step_traffic = traffic_.at(t%TRAFFIC_WINDOW);
+		for (size_t i=0; i<row_size; i++) {
+			row[i] += step_traffic[i];
+		}
+	}
+	std::vector<double> matrix;
+	if (id_ == 0) {
+		matrix.resize(nb_masters_*row_size);
+	}
+	MPI_Gather(row.data(), row_size, MPI_DOUBLE, matrix.data(), row_size, MPI_DOUBLE, 0, MasterComm_);
+
+	ubjson::Value traffic;
+	if (id_ != 0) {
+		return traffic;
+	}
+	traffic["steps"] = (unsigned long long)nb_steps;
+	auto add_entry = [&](MasterId source, MasterId destination, const char* operation,
+		const InteractionName* type, double count, double bytes) {
+		if (count == 0) {
+			return;
+		}
+		ubjson::Value entry;
+		entry["source"] = source;
+		entry["destination"] = destination;
+		entry["operation"] = operation;
+		if (type != nullptr) {
+			entry["type"] = *type;
+		}
+		entry["count"] = (unsigned long long)count;
+		entry["bytes"] = (unsigned long long)bytes;
+		traffic["traffic"].push_back(entry);
+	};
+	for (MasterId source=0; source<nb_masters_; source++) {
+		for (MasterId destination=0; destination<nb_masters_; destination++) {
+			const double* values = &matrix[source*row_size + TrafficOffset(destination)];
+			for (InteractionType type=0; type<nb_interactions_; type++) {
+				add_entry(source, destination, "interaction", &interaction_type_to_string_.at(type),
+					values[type], values[nb_interactions_ + type]);
+			}
+			values += 2*nb_interactions_;
+			add_entry(source, destination, "get", nullptr, values[0], values[1]);
+			add_entry(source, destination, "put", nullptr, values[2], values[3]);
+		}
+	}
+	return traffic;
+}
+
+
+ubjson::Value Master::StatisticsToJson(const StepStatistics &statistics, Time nb_steps) {
+	double steps = std::max(nb_steps, (Time)1);
+	ubjson::Value json;
+	double step_time = 0;
+	for (size_t i=0; i<NB_PHASES; i++) {
+		json["phases"][PHASES_NAMES[i]] = statistics.phases[i]/steps;
+		step_time += statistics.phases[i]/steps;
+	}
+	json["step_time"] = step_time;
+	for (size_t i=0; i<NB_SYNC_POINTS; i++) {
+		json["synchronizations"][SYNC_POINTS_NAMES[i]] = statistics.synchronizations[i]/steps;
+	}
+	json["interactions_sent"] = statistics.interactions_sent/steps;
+	json["interactions_received"] = statistics.interactions_received/steps;
+	json["bytes_sent"] = statistics.bytes_sent/steps;
+	json["bytes_received"] = statistics.bytes_received/steps;
+	json["gets"] = statistics.gets/steps;
+	json["puts"] = statistics.puts/steps;
+	json["rma_bytes"] = statistics.rma_bytes/steps;
+	json["cache_hit_ratio"] = statistics.public_reads > 0 ?
+		1 - statistics.gets/statistics.public_reads : 1.;
+	json["handlers_imbalance"] = statistics.handlers_mean > 0 ?
+		statistics.handlers_max/statistics.handlers_mean : 1.;
+	return json;
+}
+
+
+void Master::SetAttributesProfiling(int enabled) {
+	if (id_ == 0) {
+		// This method is a control method, so sends orders from master 0 to other
+		// masters
+		order_ = Order::ATTRIBUTES_PROFILING;
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
+	}
+	// Receives the new mode from master 0
+	MPI_Bcast(&enabled, 1, MPI_INT, 0, MasterComm_);
+	if (enabled) {
+		for (auto &counter : attributes_accesses_) {
+			counter.store(0, std::memory_order_relaxed);
+		}
+		profiled_remote_agents_.clear();
+		attributes_profile_steps_ = 0;
+	}
+	attributes_profiling_ = enabled;
+}
+
+
+ubjson::Value Master::GetAttributesProfile() {
+	if (id_ == 0) {
+		// This method is a control method, so sends orders from master 0 to other
+		// masters
+		order_ = Order::ATTRIBUTES_PROFILE;
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
+	}
+
+	// The counters of all masters are summed on master 0
+	std::vector<uint64_t> counters(attributes_accesses_.size());
+	for (size_t i=0; i<counters.size(); i++) {
+		counters[i] = attributes_accesses_[i].load(std::memory_order_relaxed);
+	}
+	std::vector<uint64_t> sums;
+	if (id_ == 0) {
+		sums.resize(counters.size());
+	}
+	MPI_Reduce(counters.data(), sums.data(), counters.size(), MPI_UINT64_T, MPI_SUM, 0, MasterComm_);
+
+	ubjson::Value profile;
+	if (id_ != 0) {
+		return profile;
+	}
+	profile["steps"] = (unsigned long long)attributes_profile_steps_;
+	for (AgentType reader=0; reader<=nb_types_; reader++) {
+		for (auto &attribute : attribute_to_string_) {
+			AgentType target = attribute.first.first;
+			const uint64_t* values = &sums[AttributeAccessOffset(reader, target, attribute.first.second)];
+			if (std::all_of(values, values + NB_ATTRIBUTE_ACCESSES, [](uint64_t v) { return v == 0; })) {
+				continue;
+			}
+			ubjson::Value entry;
+			entry["reader"] = reader < nb_types_ ? agent_type_to_string_.at(reader) : std::string();
+			entry["target"] = agent_type_to_string_.at(target);
+			entry["attribute"] = attribute.second;
+			for (size_t i=0; i<NB_ATTRIBUTE_ACCESSES; i++) {
+				entry[ATTRIBUTE_ACCESSES_NAMES[i]] = (unsigned long long)values[i];
+			}
+			profile["accesses"].push_back(entry);
+		}
+	}
+	return profile;
+}
+
+
+void Master::SetTracing(int enabled) {
+	if (id_ == 0) {
+		// This method is a control method, so sends orders from master 0 to other
+		// masters
+		order_ = Order::TRACING;
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
+	}
+	// Receives the new mode from master 0
+	MPI_Bcast(&enabled, 1, MPI_INT, 0, MasterComm_);
+	if (enabled) {
+		trace_buffers_.assign(agent_handlers_.size()+1, utils::ring_buffer<TraceEvent>(TRACE_BUFFER_SIZE));
+		// The origins of the traces of the masters are the end of this barrier
+		MPI_Barrier(MasterComm_);
+		trace_start_ = std::chrono::steady_clock::now();
+	}
+	tracing_ = enabled;
+}
+
+
+bool Master::DumpTrace(std::string file) {
+	if (id_ == 0) {
+		// This method is a control method, so sends orders from master 0 to other
+		// masters
+		order_ = Order::DUMP_TRACE;
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
+	}
+
+	// Each master writes its own events, in microseconds since trace_start_
+	std::ostringstream events;
+	events << std::fixed;
+	events.precision(3);
+	events << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << id_
+	       << ",\"args\":{\"name\":\"Master " << id_ << "\"}}";
+	for (size_t thread=0; thread<trace_buffers_.size(); thread++) {
+		events << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << id_ << ",\"tid\":" << thread
+		       << ",\"args\":{\"name\":\"" << (thread == 0 ? std::string("Master") : "Agent handler " + std::to_string(thread-1))
+		       << "\"}}";
+		const utils::ring_buffer<TraceEvent> &buffer = trace_buffers_.at(thread);
+		if (buffer.dropped() > 0) {
+			std::cerr << "Warning: master " << id_ << " dropped the " << buffer.dropped()
+			          << " oldest events of thread " << thread << " from its trace." << std::endl;
+		}
+		for (size_t i=0; i<buffer.size(); i++) {
+			const TraceEvent &event = buffer.at(i);
+			std::chrono::duration<double, std::micro> begin = event.begin - trace_start_;
+			std::chrono::duration<double, std::micro> duration = event.end - event.begin;
+			events << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":" << id_
+			       << ",\"tid\":" << thread << ",\"ts\":" << begin.count() << ",\"dur\":" << duration.count() << "}";
+		}
+	}
+	std::string local_events = events.str();
+
+	// Gathering the events on master 0
+	int local_size = local_events.size();
+	std::vector<int> sizes;
+	std::vector<int> displs;
+	if (id_ == 0) {
+		sizes.resize(nb_masters_);
+	}
+	MPI_Gather(&local_size, 1, MPI_INT, sizes.data(), 1, MPI_INT, 0, MasterComm_);
+	std::string all_events;
+	if (id_ == 0) {
+		displs.resize(nb_masters_, 0);
+		for (int i=1; i<nb_masters_; i++) {
+			displs.at(i) = displs.at(i-1) + sizes.at(i-1);
+		}
+		all_events.resize(displs.back() + sizes.back());
+	}
+	MPI_Gatherv((void*)local_events.data(), local_size, MPI_CHAR, (void*)all_events.data(), sizes.data(),
+		displs.data(), MPI_CHAR, 0, MasterComm_);
+
+	if (id_ == 0) {
+		std::ofstream output(file);
+		if (!output) {
+			std::cerr << "The trace can not be written to " << file << "." << std::endl;
+			return false;
+		}
+		output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		for (int i=0; i<nb_masters_; i++) {
+			if (i > 0) {
+				output << ",\n";
+			}
+			output.write(all_events.data() + displs.at(i), sizes.at(i));
+		}
+		output << "\n]}\n";
+		if (!output) {
+			std::cerr << "The trace can not be written to " << file << "." << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+
+bool Master::ExportSimulationAsync(std::string file) {
+	std::ofstream output;
+	if (id_ == 0) {
+		// Only one export is written at a time, so that the snapshots do not
+		// accumulate in memory
+		WaitExport();
+		// The file is opened before the snapshot, so that an export which can
+		// not be written fails immediately
+		output.open(file);
+		if (!output) {
+			std::cerr << "The export can not be written to " << file << "." << std::endl;
+			return false;
+		}
+		// This method is a control method, so sends orders from master 0 to other
+		// masters
+		order_ = Order::EXPORT_SIMULATION_ASYNC;
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
+	}
+
+	// Snapshot of the sendable attributes of the agents, each structure being
+	// stored in a slot of max_agent_size_ bytes
+	std::unordered_map<AgentType, size_t> structs_sizes = AgentStructsSizes();
+	std::vector<char> local_snapshot(agents_.size()*max_agent_size_);
+	size_t k = 0;
+	for (auto &agent : agents_) {
+		agent.second->CreateStruct();
+		memcpy(local_snapshot.data() + k*max_agent_size_, agent.second->structure_,
+			structs_sizes.at(agent.second->type_));
+		free(agent.second->structure_);
+		agent.second->structure_ = nullptr;
+		k++;
+	}
+
+	// Gathering the snapshots on master 0
+	int local_size = local_snapshot.size();
+	std::vector<int> sizes;
+	std::vector<int> displs;
+	if (id_ == 0) {
+		sizes.resize(nb_masters_);
+	}
+	MPI_Gather(&local_size, 1, MPI_INT, sizes.data(), 1, MPI_INT, 0, MasterComm_);
+	std::vector<char> snapshot;
+	if (id_ == 0) {
+		displs.resize(nb_masters_, 0);
+		for (int i=1; i<nb_masters_; i++) {
+			displs.at(i) = displs.at(i-1) + sizes.at(i-1);
+		}
+		snapshot.resize(displs.back() + sizes.back());
+	}
+	MPI_Gatherv(local_snapshot.data(), local_size, MPI_BYTE, snapshot.data(), sizes.data(), displs.data(),
+		MPI_BYTE, 0, MasterComm_);
+	if (id_ != 0) {
+		return true;
+	}
+
+	// The snapshot is converted and written while the simulation goes on
+	export_thread_ = std::thread([this, file](std::vector<char> snapshot, std::ofstream output) {
+		ubjson::Value agents;
+		for (size_t k=0; k<snapshot.size()/max_agent_size_; k++) {
+			std::unique_ptr<Agent> agent = Agent::FromStruct(snapshot.data() + k*max_agent_size_, id_, *this);
+			agents[agent_type_to_string_.at(agent->type_)].push_back(agent->GetJsonNode());
+		}
+		ubjson::Value json;
+		json["agents"] = std::move(agents);
+		output << ubjson::to_ostream(json, ubjson::to_ostream::pretty) << std::endl;
+		if (!output) {
+			std::cerr << "The export can not be written to " << file << "." << std::endl;
+		}
+	}, std::move(snapshot), std::move(output));
+	return true;
+}
+
+
+void Master::WaitExport() {
+	if (export_thread_.joinable()) {
+		export_thread_.join();
+	}
+}
+
+
+void Master::KillSimulation() {
+	if (id_ == 0) {
+		order_ = Order::KILL_SIMULATION;
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
+	}
+}
+
+
+void Master::WaitOrderFromRoot() {
+	if (id_ == 0)
+		return;
+	while (order_ != Order::KILL_SIMULATION) {
+		order_ = Order::IDLE;
+		// Waits for an order of master 0
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
+		switch (order_) {
+			case Order::RUN_SIMULATION: {
+				RunSimulation();
+				break;
+			}
+			case Order::RUN_BATCH: {
+				RunBatch();
+				break;
+			}
+			case Order::CHANGE_PERIOD: {
+				ChangePeriod(0);
+				break;
+			}
+			case Order::ADD_AGENTS: {
+				// Meaningless vector used to be able to call the following method
+				std::vector<void*> artefact = {};
+				AddUserAgents(artefact);
+				break;
+			}
+			case Order::MODIFY_ATTRIBUTES: {
+				ModifyAttributes();
+				break;
+			}
+			case Order::MODIFY_ATTRIBUTE: {
+				ModifyAttribute();
+				break;
+			}
+			case Order::EXPORT_SIMULATION: {
+				ExportSimulation();
+				break;
+			}
+			case Order::EXPORT_SIMULATION_ASYNC: {
+				ExportSimulationAsync();
+				break;
+			}
+			case Order::GET_AGENT: {
+				GetAgentJsonNode();
+				break;
+			}
+			case Order::AGGREGATE: {
+				Aggregate();
+				break;
+			}
+			case Order::ADD_PROBE: {
+				AddProbe();
+				break;
+			}
+			case Order::CLEAR_PROBES: {
+				ClearProbes();
+				break;
+			}
+			case Order::CHANGE_NB_AGENT_HANDLERS: {
+				ChangeNbAgentHandlers();
+				break;
+			}
+			case Order::STATISTICS: {
+				GetStatistics();
+				break;
+			}
+			case Order::PHASE_TIMINGS: {
+				GetPhaseTimings();
+				break;
+			}
+			case Order::TRAFFIC_MATRIX: {
+				GetTrafficMatrix();
+				break;
+			}
+			case Order::ATTRIBUTES_PROFILING: {
+				SetAttributesProfiling();
+				break;
+			}
+			case Order::ATTRIBUTES_PROFILE: {
+				GetAttributesProfile();
+				break;
+			}
+			case Order::TRACING: {
+				SetTracing();
+				break;
+			}
+			case Order::DUMP_TRACE: {
+				DumpTrace();
+				break;
+			}
+			default:
+				continue;
+		}
+	}
+}
+
+
+void Master::ConvertOutputToInput(std::string in, std::string out) {
+	std::ifstream file_in(in, std::ios::in);
+	ubjson::StreamReader<std::ifstream> reader(file_in);
+	ubjson::Value agents = reader.getNextValue();
+	file_in.close();
+
+	ubjson::Value agent_types;
+	for (auto &x : agent_type_to_string_) {
+		ubjson::Value agent_type;
+		agent_type["type"] = x.second;
+		agent_type["number"] = (int)agents["agents"][x.second].size();
+		agent_type["agents"] = agents["agents"][x.second];
+		agent_types.push_back(std::move(agent_type));
+	}
+
+	ubjson::Value result;
+	result["agent_types"] = agent_types;
+	std::ofstream file_out(out, std::ios::out);
+	file_out << ubjson::to_ostream(result, ubjson::to_ostream::pretty) << std::endl;
+	file_in.close();
+
+}
+
+
+AgentGlobalId Master::LocalToGlobalId(AgentId id, AgentType type) {
+	return nb_types_*id + type;
+}
+
+
+AgentId Master::GlobalToLocalId(AgentGlobalId id) {
+	return id / nb_types_;
+}
 
 
 AgentType Master::GlobalToLocalType(AgentGlobalId id) {
@@ -416,9 +1479,7 @@ size_t Master::PublicWindowsSize() {
 
 
 size_t Master::CriticalWindowsSize() {
-	size_t result;
-	MPI_Win_get_attr(critical_window_, MPI_WIN_SIZE, &result, NULL);
-	return result;
+	return CriticalWindowDescription.size;
 }
 
 
@@ -446,7 +1507,7 @@ bool Master::HasReceivedAttribute(Attribute attr, AgentGlobalId id, void* &locat
 }
 
 
-void Master::InitializeAgents(std::vector<void*> &initial_agents) {
+void Master::InitializeAgents(std::vector<void*> &initial_agents, const PlacementDescription &placement) {
 
 	// Initalizes send parameters for master 0
 	uint64_t nb_agents = initial_agents.size();
@@ -478,8 +1539,29 @@ void Master::InitializeAgents(std::vector<void*> &initial_agents) {
 	// Master 0 assigns and sends the agents, and sends to each master how many
 	// agents it will receive and from which type and other infos about the
 	// agents
+	std::vector<void*> sent_agents;
 	if (id_ == 0) {
-		AssignInitialMasters(initial_agents, assignment, nb_masters_);
+		std::vector<AgentEdge> edges;
+		std::vector<uint64_t> weights;
+		std::vector<std::vector<double>> coordinates;
+		std::vector<size_t> order;
+		BuildInteractionGraph(initial_agents, placement, edges, weights);
+		BuildCoordinates(initial_agents, placement, coordinates);
+		AssignInitialMasters(initial_agents, edges, weights, coordinates, placement.heuristic,
+			assignment, order, nb_masters_);
+
+		// The agents are sent in the order given by the heuristic, so that each
+		// master receives close agents one after the other
+		std::vector<MasterId> ordered_assignment(nb_agents);
+		std::vector<AgentGlobalId> ordered_ids(nb_agents);
+		sent_agents.resize(nb_agents);
+		for (size_t k=0; k<nb_agents; k++) {
+			ordered_assignment.at(k) = assignment.at(order.at(k));
+			ordered_ids.at(k) = agent_ids.at(order.at(k));
+			sent_agents.at(k) = initial_agents.at(order.at(k));
+		}
+		assignment.swap(ordered_assignment);
+		agent_ids.swap(ordered_ids);
 	}
 	// Sending assignment and agent_ids
 	MPI_Bcast(assignment.data(), nb_agents, MPI_INT, 0, MasterComm_);
@@ -488,7 +1570,7 @@ void Master::InitializeAgents(std::vector<void*> &initial_agents) {
 	if (id_ == 0) {
 		// Sending agents
 		for (size_t k=0; k<nb_sends; k++) {
-			AgentStruct *agent = (AgentStruct*)initial_agents.at(k);
+			AgentStruct *agent = (AgentStruct*)sent_agents.at(k);
 			MPI_Isend(agent, 1, agents_MPI_types_.at(agent->type), assignment.at(k),
 				0, MasterComm_, &send_requests.at(k));
 		}
@@ -496,8 +1578,10 @@ void Master::InitializeAgents(std::vector<void*> &initial_agents) {
 
 	// Computing the number of agents to receive and updating the masters info
 	size_t nb_receives = 0;
+	nb_agents_by_master_.assign(nb_masters_, 0);
 	for (size_t k=0; k<nb_agents; k++) {
 		masters_.insert(std::make_pair(agent_ids.at(k), assignment.at(k)));
+		nb_agents_by_master_.at(assignment.at(k))++;
 		if (assignment.at(k) == id_) {
 			nb_receives++;
 		}
@@ -531,6 +1615,86 @@ void Master::InitializeAgents(std::vector<void*> &initial_agents) {
 }
 
 
+void Master::BuildInteractionGraph(std::vector<void*> &initial_agents, const PlacementDescription &placement,
+	std::vector<AgentEdge> &edges, std::vector<uint64_t> &weights)
+{
+	size_t nb_agents = initial_agents.size();
+	edges = placement.edges;
+
+	// Weights of the agents and position of each agent in initial_agents
+	weights.assign(nb_agents, 1);
+	std::unordered_map<AgentGlobalId, size_t> indices;
+	for (size_t k=0; k<nb_agents; k++) {
+		AgentStruct *agent = (AgentStruct*)initial_agents.at(k);
+		indices.insert(std::make_pair(LocalToGlobalId(agent->id, agent->type), k));
+		auto weight = placement.type_weights.find(agent->type);
+		if (weight != placement.type_weights.end()) {
+			weights.at(k) = weight->second;
+		}
+	}
+
+	// Edges derived from the attributes: the value of the attribute is read in
+	// a temporary agent built from the structure
+	for (auto &link : placement.attribute_links) {
+		auto size = attributes_sizes_.find(std::make_pair(link.type, link.attribute));
+		if (size == attributes_sizes_.end())
+			continue;
+		for (size_t k=0; k<nb_agents; k++) {
+			if (((AgentStruct*)initial_agents.at(k))->type != link.type)
+				continue;
+			std::unique_ptr<Agent> agent = Agent::FromStruct(initial_agents.at(k), id_, *this);
+			void* location = agent->GetPointerToAttribute(link.attribute);
+			if (location == nullptr)
+				continue;
+			AgentId target_id;
+			switch (size->second) {
+				case 1: target_id = *(uint8_t*)location; break;
+				case 2: target_id = *(uint16_t*)location; break;
+				case 4: target_id = *(uint32_t*)location; break;
+				case 8: target_id = *(uint64_t*)location; break;
+				default: continue;
+			}
+			auto target = indices.find(LocalToGlobalId(target_id, link.target_type));
+			if (target != indices.end()) {
+				edges.push_back(AgentEdge{k, target->second, link.weight});
+			}
+		}
+	}
+}
+
+
+void Master::BuildCoordinates(std::vector<void*> &initial_agents, const PlacementDescription &placement,
+	std::vector<std::vector<double>> &coordinates)
+{
+	size_t nb_agents = initial_agents.size();
+	coordinates.assign(nb_agents, std::vector<double>());
+	if (placement.heuristic != PlacementHeuristic::Hilbert && placement.heuristic != PlacementHeuristic::Morton)
+		return;
+
+	for (size_t k=0; k<nb_agents; k++) {
+		AgentType type = ((AgentStruct*)initial_agents.at(k))->type;
+		auto attributes = placement.coordinates.find(type);
+		if (attributes == placement.coordinates.end())
+			continue;
+		std::unique_ptr<Agent> agent = Agent::FromStruct(initial_agents.at(k), id_, *this);
+		std::vector<double> &position = coordinates.at(k);
+		for (Attribute attr : attributes->second) {
+			void* location = agent->GetPointerToAttribute(attr);
+			auto mpi_type = attributes_MPI_types_.find(std::make_pair(type, attr));
+			if (location == nullptr || mpi_type == attributes_MPI_types_.end())
+				break;
+			AttributeReader read = GetAttributeReader(mpi_type->second);
+			if (read == nullptr)
+				break;
+			position.push_back(read(location));
+		}
+		if (position.size() != attributes->second.size()) {
+			position.clear();
+		}
+	}
+}
+
+
 void Master::InitializeWindows(std::vector<AgentGlobalId> &agent_ids) {
 
 	// Sorting the agent global ids so that the next operations will be the same
@@ -538,17 +1702,23 @@ void Master::InitializeWindows(std::vector<AgentGlobalId> &agent_ids) {
 	std::sort(agent_ids.begin(), agent_ids.end());
 
 	PublicWindowsDescription.resize(nb_masters_);
+	free_public_slots_.resize(nb_masters_);
 
 	for(auto x: PublicWindowsDescription) {
 		x.size = 0;
 		x.used = 0;
 	}
 	CriticalWindowDescription.size = 0;
+	CriticalWindowDescription.used = 0;
 
 	// Construction of public_storage_sizes_, critical_storage_size_ and filling
 	// of public_agents_offsets_ and critical_agents_offsets_
 	// Initialization of maximal_ids_
 	maximal_ids_.assign(nb_types_, 0);
+	fresh_ids_ = std::vector<std::atomic<AgentId>>(nb_types_);
+	for (auto &fresh : fresh_ids_) {
+		fresh.store(0);
+	}
 	agent_ids_by_types_.resize(nb_types_);
 	for (auto &global_id : agent_ids) {
 		AgentType type = GlobalToLocalType(global_id);
@@ -557,9 +1727,9 @@ void Master::InitializeWindows(std::vector<AgentGlobalId> &agent_ids) {
 		maximal_ids_.at(type) = std::max(maximal_ids_.at(type), GlobalToLocalId(global_id)+1);
 		MasterId master_id = masters_.at(global_id);
 		public_agents_offsets_.insert(std::make_pair(global_id, PublicWindowsDescription.at(master_id).used));
-		critical_agents_offsets_.insert(std::make_pair(global_id, CriticalWindowDescription.size));
+		critical_agents_offsets_.insert(std::make_pair(global_id, CriticalWindowDescription.used));
 		PublicWindowsDescription.at(master_id).used += public_attributes_struct_sizes_.at(type);
-		CriticalWindowDescription.size += critical_attributes_struct_sizes_.at(type);
+		CriticalWindowDescription.used += critical_attributes_struct_sizes_.at(type);
 	}
 
 	// Choosing the size of all public windows
@@ -574,8 +1744,9 @@ void Master::InitializeWindows(std::vector<AgentGlobalId> &agent_ids) {
 
 
 	// Construction of the windows
-	MPI_Win_allocate(2*max_public_used, 1, MPI_INFO_NULL, MasterComm_, &begin_public_window_, &public_window_);
-	MPI_Win_allocate(2*CriticalWindowDescription.size, 1, MPI_INFO_NULL, MasterComm_, &begin_critical_window_, &critical_window_);
+	begin_public_window_ = CreatePublicWindow(2*max_public_used, node_public_window_, public_window_);
+	CriticalWindowDescription.size = 2*CriticalWindowDescription.used;
+	begin_critical_window_ = CreateCriticalWindow(CriticalWindowDescription.size, node_critical_window_, critical_window_);
 
 	// Now that the agents were received, fills the windows with their content
 	FillWindows(agent_ids);
@@ -585,23 +1756,35 @@ void Master::InitializeWindows(std::vector<AgentGlobalId> &agent_ids) {
 
 void Master::FillWindows(std::vector<AgentGlobalId> &agent_ids) {
 
+	// The critical window is only written by its holder on each node, the other
+	// masters receive the critical attributes in a scratch buffer
+	bool holder = (node_masters_.at(0) == id_);
+	size_t max_critical_size = 0;
+	for (auto &size : critical_attributes_struct_sizes_) {
+		max_critical_size = std::max(max_critical_size, size.second);
+	}
+	std::vector<char> scratch(max_critical_size);
+
 	for (auto &global_id : agent_ids) {
+		void* critical_location = scratch.data();
+		if (holder) {
+			critical_location = static_cast<char*>(begin_critical_window_) + critical_agents_offsets_.at(global_id);
+		}
 		// Copying
 		if (masters_.at(global_id) == id_) {
 			Agent* agent = agents_.at(global_id);
 			void* public_location = static_cast<char*>(begin_public_window_) + public_agents_offsets_.at(global_id);
-			void* critical_location = static_cast<char*>(begin_critical_window_) + critical_agents_offsets_.at(global_id);
 			agent->CopyPublicAttributes(public_location);
 			agent->CopyCriticalAttributes(critical_location);
 		}
 		if (critical_structs_MPI_types_.find(GlobalToLocalType(global_id))
 			  != critical_structs_MPI_types_.end())
 		{
-			void* location = static_cast<char*>(begin_critical_window_) + critical_agents_offsets_.at(global_id);
-			MPI_Bcast(location, 1, critical_structs_MPI_types_.at(GlobalToLocalType(global_id)),
+			MPI_Bcast(critical_location, 1, critical_structs_MPI_types_.at(GlobalToLocalType(global_id)),
 				masters_.at(global_id), MasterComm_);
 		}
 	}
+	SynchronizeNodeWindows();
 
 }
 
@@ -615,6 +1798,156 @@ void Master::AddAgent(AgentHandler &agent_handler, void* structure) {
 }
 
 
+void Master::RemoveAgent(AgentGlobalId id) {
+	auto key = std::make_pair(GlobalToLocalId(id), GlobalToLocalType(id));
+	for (auto &agent_handler : agent_handlers_) {
+		if (agent_handler.agents.find(key) != agent_handler.agents.end()) {
+			agent_handler.DeleteAgent(key.first, key.second);
+			break;
+		}
+	}
+	agents_.erase(id);
+}
+
+
+void Master::CountTraffic(Agent* agent, MasterId master) {
+	if (master == id_) {
+		agent->traffic_.local++;
+	} else {
+		agent->traffic_.remote[master]++;
+	}
+}
+
+
+size_t Master::AllocatePublicSlot(MasterId master, AgentType type) {
+	std::vector<size_t> &free_slots = free_public_slots_.at(master)[type];
+	if (!free_slots.empty()) {
+		size_t offset = free_slots.back();
+		free_slots.pop_back();
+		return offset;
+	}
+	size_t offset = PublicWindowsDescription.at(master).used;
+	PublicWindowsDescription.at(master).used += public_attributes_struct_sizes_.at(type);
+	return offset;
+}
+
+
+void Master::FreePublicSlot(MasterId master, AgentType type, size_t offset) {
+	free_public_slots_.at(master)[type].push_back(offset);
+}
+
+
+size_t Master::AllocateCriticalSlot(AgentType type) {
+	std::vector<size_t> &free_slots = free_critical_slots_[type];
+	if (!free_slots.empty()) {
+		size_t offset = free_slots.back();
+		free_slots.pop_back();
+		return offset;
+	}
+	size_t offset = CriticalWindowDescription.used;
+	CriticalWindowDescription.used += critical_attributes_struct_sizes_.at(type);
+	return offset;
+}
+
+
+void Master::FreeCriticalSlot(AgentType type, size_t offset) {
+	free_critical_slots_[type].push_back(offset);
+}
+
+
+void Master::ResizePublicWindows(size_t new_size) {
+	MPI_Win new_node_window, new_window;
+	void* new_begin = CreatePublicWindow(new_size, new_node_window, new_window);
+	memcpy(new_begin, begin_public_window_, std::min(new_size, PublicWindowsDescription.at(id_).size));
+	FreeWindow(node_public_window_, public_window_);
+	node_public_window_ = new_node_window;
+	public_window_ = new_window;
+	begin_public_window_ = new_begin;
+	for (auto &x: PublicWindowsDescription) {
+		x.size = new_size;
+	}
+	SynchronizeNodeWindows();
+}
+
+
+void Master::ResizeCriticalWindow(size_t new_size) {
+	MPI_Win new_node_window, new_window;
+	void* new_begin = CreateCriticalWindow(new_size, new_node_window, new_window);
+	if (node_masters_.at(0) == id_) {
+		memcpy(new_begin, begin_critical_window_, std::min(new_size, CriticalWindowDescription.size));
+	}
+	FreeWindow(node_critical_window_, critical_window_);
+	node_critical_window_ = new_node_window;
+	critical_window_ = new_window;
+	begin_critical_window_ = new_begin;
+	CriticalWindowDescription.size = new_size;
+	SynchronizeNodeWindows();
+}
+
+
+void* Master::CreatePublicWindow(size_t size, MPI_Win &node_window, MPI_Win &window) {
+	void* begin;
+	MPI_Info info;
+	MPI_Info_create(&info);
+	MPI_Info_set(info, "alloc_shared_noncontig", "true");
+	MPI_Win_allocate_shared(size, 1, info, NodeComm_, &begin, &node_window);
+	MPI_Info_free(&info);
+	MPI_Win_create(begin, size, 1, MPI_INFO_NULL, MasterComm_, &window);
+	// The shared memory window stays in a passive epoch until it is freed, so
+	// that MPI_Win_sync can be used on it
+	MPI_Win_lock_all(MPI_MODE_NOCHECK, node_window);
+	for (size_t rank=0; rank<node_masters_.size(); rank++) {
+		MPI_Aint shared_size;
+		int disp_unit;
+		void* shared_begin;
+		MPI_Win_shared_query(node_window, rank, &shared_size, &disp_unit, &shared_begin);
+		colocated_public_windows_.at(node_masters_.at(rank)) = static_cast<char*>(shared_begin);
+	}
+	return begin;
+}
+
+
+void* Master::CreateCriticalWindow(size_t size, MPI_Win &node_window, MPI_Win &window) {
+	void* local_begin;
+	size_t local_size = (node_masters_.at(0) == id_) ? size : 0;
+	MPI_Win_allocate_shared(local_size, 1, MPI_INFO_NULL, NodeComm_, &local_begin, &node_window);
+	MPI_Win_create(local_begin, local_size, 1, MPI_INFO_NULL, MasterComm_, &window);
+	MPI_Win_lock_all(MPI_MODE_NOCHECK, node_window);
+	MPI_Aint shared_size;
+	int disp_unit;
+	void* begin;
+	MPI_Win_shared_query(node_window, 0, &shared_size, &disp_unit, &begin);
+	return begin;
+}
+
+
+void Master::FreeWindow(MPI_Win &node_window, MPI_Win &window) {
+	MPI_Win_free(&window);
+	MPI_Win_unlock_all(node_window);
+	MPI_Win_free(&node_window);
+}
+
+
+void Master::SynchronizeNodeWindows() {
+	MPI_Win_sync(node_public_window_);
+	MPI_Win_sync(node_critical_window_);
+}
+
+
+void Master::GrowWindows() {
+	size_t max_public_used = 0;
+	for (auto &x: PublicWindowsDescription) {
+		max_public_used = std::max(max_public_used, x.used);
+	}
+	if (max_public_used > PublicWindowsDescription.at(id_).size) {
+		ResizePublicWindows(2*max_public_used);
+	}
+	if (CriticalWindowDescription.used > CriticalWindowDescription.size) {
+		ResizeCriticalWindow(2*CriticalWindowDescription.used);
+	}
+}
+
+
 void Master::Synchronize() {
 	// Synchronizes the masters using MPI
 	MPI_Barrier(MasterComm_);
@@ -625,7 +1958,12 @@ void Master::DistributeReceivedInteractions() {
 	AgentGlobalId agent;
 	for (auto &inter : received_interactions_) {
 		agent = LocalToGlobalId(inter->recipient_id_, inter->recipient_type_);
-		agents_.at(agent)->ReceiveMessage(inter);
+		Agent* recipient = agents_.at(agent);
+		auto sender_master = masters_.find(LocalToGlobalId(inter->sender_id_, inter->sender_type_));
+		if (sender_master != masters_.end()) {
+			CountTraffic(recipient, sender_master->second);
+		}
+		recipient->ReceiveMessage(inter);
 	}
 	received_interactions_.clear();
 }
@@ -634,35 +1972,85 @@ void Master::DistributeReceivedInteractions() {
 void Master::RunBehaviors() {
 	received_public_attributes_.clear();
 	stored_public_attributes_.clear();
-	size_t n = agent_handlers_.size();
+	SynchronizeNodeWindows();
 	MPI_Win_lock_all(MPI_MODE_NOCHECK, public_window_);
-	std::vector<std::thread> threads;
-	for (size_t i=0; i<n; i++) {
-		threads.emplace_back(&AgentHandler::RunBehaviors, &(agent_handlers_.at(i)));
-	}
-	for (size_t i=0; i<n; i++) {
-		threads.at(i).join();
-	}
+	RunAgentHandlers(&AgentHandler::RunBehaviors, "RunBehaviors", public_window_);
 	MPI_Win_unlock_all(public_window_);
 }
 
 
-void* Master::GetPublicAttribute(Attribute attr, AgentGlobalId recipient) {
+void* Master::GetPublicAttribute(Attribute attr, AgentGlobalId recipient, Agent* reader) {
 	AgentType agent_type = GlobalToLocalType(recipient);
 	auto p_type  = std::make_pair(agent_type, attr);
 	auto p_id = std::make_pair(recipient, attr);
+	MasterId master_recipient_id = masters_.at(recipient);
+	if (reader != nullptr) {
+		CountTraffic(reader, master_recipient_id);
+	}
+	thread_public_reads++;
+	// The public windows of the masters of the same node are read directly
+	char* colocated_window = colocated_public_windows_.at(master_recipient_id);
+	if (colocated_window != nullptr) {
+		if (attributes_profiling_) {
+			CountAttributeAccess(reader, recipient, attr,
+				master_recipient_id == id_ ? AttributeAccess::LOCAL : AttributeAccess::COLOCATED);
+		}
+		return colocated_window + PublicTargetDisp(recipient, attr);
+	}
 	void* location = nullptr;
 	if (HasReceivedAttribute(attr, recipient, location)) {
+		if (attributes_profiling_) {
+			CountAttributeAccess(reader, recipient, attr,
+				master_recipient_id == id_ ? AttributeAccess::LOCAL : AttributeAccess::CACHE_HIT);
+		}
 		return location;
-	} else {
-		MasterId master_recipient_id = masters_.at(recipient);
-		MPI_Datatype MPI_attr_type = attributes_MPI_types_.at(p_type);
-		size_t target_disp = PublicTargetDisp(recipient, attr);
-		void* storage_location = stored_public_attributes_.allocate(attributes_sizes_.at(p_type));
-		received_public_attributes_.set(p_id, storage_location);
-		MPI_Get(storage_location, 1, MPI_attr_type, master_recipient_id,
-			target_disp, 1, MPI_attr_type, public_window_);
-		return storage_location;
+	}
+	if (master_recipient_id != id_) {
+		// Replicated agents are read from their copy received at the beginning
+		// of the time step
+		remotely_read_agents_.insert(std::make_pair(recipient, true));
+		auto replica = replicas_offsets_.find(recipient);
+		if (replica != replicas_offsets_.end()) {
+			if (attributes_profiling_) {
+				CountAttributeAccess(reader, recipient, attr, AttributeAccess::REPLICA);
+			}
+			location = replicas_.data() + replica->second + public_attributes_offsets_.at(p_type);
+			received_public_attributes_.set(p_id, location);
+			return location;
+		}
+	}
+	if (attributes_profiling_) {
+		CountAttributeAccess(reader, recipient, attr,
+			master_recipient_id == id_ ? AttributeAccess::LOCAL : AttributeAccess::CACHE_MISS);
+	}
+	// The get is made by the communication thread, the attribute is only
+	// remembered once it arrived
+	std::atomic<void*> result(nullptr);
+	RmaRequest request;
+	request.get = true;
+	request.size = attributes_sizes_.at(p_type);
+	request.datatype = attributes_MPI_types_.at(p_type);
+	request.target = master_recipient_id;
+	request.target_disp = PublicTargetDisp(recipient, attr);
+	request.result = &result;
+	rma_requests_.push(request);
+	void* storage_location;
+	while ((storage_location = result.load(std::memory_order_acquire)) == nullptr) {
+		std::this_thread::yield();
+	}
+	received_public_attributes_.set(p_id, storage_location);
+	return storage_location;
+}
+
+
+void Master::CountAttributeAccess(Agent* reader, AgentGlobalId recipient, Attribute attr, AttributeAccess access) {
+	size_t offset = AttributeAccessOffset(reader != nullptr ? reader->type_ : nb_types_,
+		GlobalToLocalType(recipient), attr);
+	attributes_accesses_.at(offset + static_cast<size_t>(access)).fetch_add(1, std::memory_order_relaxed);
+	if (access != AttributeAccess::CRITICAL && access != AttributeAccess::LOCAL
+		&& profiled_remote_agents_.insert(std::make_pair(std::make_pair(recipient, offset), true))) {
+		attributes_accesses_.at(offset + static_cast<size_t>(AttributeAccess::DISTINCT_REMOTE_AGENTS))
+			.fetch_add(1, std::memory_order_relaxed);
 	}
 }
 
@@ -676,16 +2064,170 @@ void* Master::GetCriticalAttribute(Attribute attr, AgentGlobalId recipient) {
 
 
 void Master::UpdateAllPublicAttributes() {
+	MPI_Win_lock_all(MPI_MODE_NOCHECK, critical_window_);
+	RunAgentHandlers(&AgentHandler::UpdateAllPublicAttributes, "UpdateAllPublicAttributes", critical_window_);
+	MPI_Win_unlock_all(critical_window_);
+	SynchronizeNodeWindows();
+}
+
+
+void Master::RunAgentHandlers(void (AgentHandler::*phase)(), const char* name, MPI_Win window) {
 	size_t n = agent_handlers_.size();
+	if (tracing_ && trace_buffers_.size() < n+1) {
+		trace_buffers_.resize(n+1, utils::ring_buffer<TraceEvent>(TRACE_BUFFER_SIZE));
+	}
+	std::atomic<size_t> running(n);
 	std::vector<std::thread> threads;
-	MPI_Win_lock_all(MPI_MODE_NOCHECK, critical_window_);
+	std::vector<double> durations(n);
+	std::vector<uint64_t> public_reads(n);
 	for (size_t i=0; i<n; i++) {
-		threads.emplace_back(&AgentHandler::UpdateAllPublicAttributes, &(agent_handlers_.at(i)));
+		threads.emplace_back([this, phase, name, i, &running, &durations, &public_reads]() {
+			auto start = std::chrono::steady_clock::now();
+			thread_public_reads = 0;
+			(agent_handlers_.at(i).*phase)();
+			std::chrono::duration<double> duration = Trace(i+1, name, start) - start;
+			durations.at(i) = duration.count();
+			public_reads.at(i) = thread_public_reads;
+			running.fetch_sub(1, std::memory_order_release);
+		});
+	}
+
+	// Serving the one-sided operations until all agent handlers finished and
+	// the queue is empty
+	std::vector<RmaRequest> pending_gets;
+	bool finished = false;
+	while (!finished) {
+		// Every request pushed before the last agent handler finished is popped
+		// in this iteration
+		finished = (running.load(std::memory_order_acquire) == 0);
+		bool served = false;
+		RmaRequest request;
+		while (rma_requests_.try_pop(request)) {
+			served = true;
+			step_statistics_.rma_bytes += request.size;
+			// Gets, their bytes, puts and their bytes follow the interactions
+			double* traffic = &step_traffic_.at(TrafficOffset(request.target) + 2*nb_interactions_);
+			traffic[request.get ? 0 : 2]++;
+			traffic[request.get ? 1 : 3] += request.size;
+			if (request.get) {
+				step_statistics_.gets++;
+				request.location = stored_public_attributes_.allocate(request.size);
+				MPI_Get(request.location, 1, request.datatype, request.target,
+					request.target_disp, 1, request.datatype, window);
+				pending_gets.push_back(request);
+			} else {
+				step_statistics_.puts++;
+				MPI_Put(request.location, 1, request.datatype, request.target,
+					request.target_disp, 1, request.datatype, window);
+			}
+		}
+		if (!pending_gets.empty()) {
+			MPI_Win_flush_local_all(window);
+			for (auto &get : pending_gets) {
+				get.result->store(get.location, std::memory_order_release);
+			}
+			pending_gets.clear();
+		}
+		if (!served) {
+			// Polling MPI lets the operations of the other masters progress
+			int flag;
+			MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MasterComm_, &flag, MPI_STATUS_IGNORE);
+			std::this_thread::yield();
+		}
 	}
+
 	for (size_t i=0; i<n; i++) {
 		threads.at(i).join();
 	}
-	MPI_Win_unlock_all(critical_window_);
+	if (n > 0) {
+		step_statistics_.handlers_max += *std::max_element(durations.begin(), durations.end());
+		step_statistics_.handlers_mean += std::accumulate(durations.begin(), durations.end(), 0.)/n;
+		step_statistics_.public_reads += std::accumulate(public_reads.begin(), public_reads.end(), (uint64_t)0);
+	}
+}
+
+
+void Master::ReplicatePublicAttributes() {
+	if (step_%REPLICATION_PERIOD == 0) {
+		// Sending the agents read remotely by this master to their masters
+		std::vector<std::vector<AgentGlobalId>> read_by_owner(nb_masters_);
+		for (auto &agent : remotely_read_agents_.raw()) {
+			auto owner = masters_.find(agent.first);
+			if (owner != masters_.end()) {
+				read_by_owner.at(owner->second).push_back(agent.first);
+			}
+		}
+		remotely_read_agents_.clear();
+		std::vector<int> send_counts(nb_masters_);
+		std::vector<int> send_disps(nb_masters_, 0);
+		std::vector<AgentGlobalId> local_read_agents;
+		for (MasterId m=0; m<nb_masters_; m++) {
+			send_counts.at(m) = read_by_owner.at(m).size();
+			send_disps.at(m) = local_read_agents.size();
+			local_read_agents.insert(local_read_agents.end(), read_by_owner.at(m).begin(), read_by_owner.at(m).end());
+		}
+		std::vector<int> receive_counts(nb_masters_);
+		MPI_Alltoall(send_counts.data(), 1, MPI_INT, receive_counts.data(), 1, MPI_INT, MasterComm_);
+		std::vector<int> receive_disps(nb_masters_, 0);
+		for (MasterId m=1; m<nb_masters_; m++) {
+			receive_disps.at(m) = receive_disps.at(m-1) + receive_counts.at(m-1);
+		}
+		std::vector<AgentGlobalId> read_agents(receive_disps.back() + receive_counts.back());
+		MPI_Alltoallv(local_read_agents.data(), send_counts.data(), send_disps.data(), MPI_UINT64_T,
+			read_agents.data(), receive_counts.data(), receive_disps.data(), MPI_UINT64_T, MasterComm_);
+
+		// Each master elects its own agents read by many masters, and only the
+		// elected agents are gathered on all masters
+		std::vector<AgentGlobalId> local_replicated_agents;
+		ChooseReplicatedAgents(read_agents, nb_masters_, local_replicated_agents);
+		std::vector<int> counts(nb_masters_);
+		int local_count = local_replicated_agents.size();
+		MPI_Allgather(&local_count, 1, MPI_INT, counts.data(), 1, MPI_INT, MasterComm_);
+		std::vector<int> disps(nb_masters_, 0);
+		for (MasterId m=1; m<nb_masters_; m++) {
+			disps.at(m) = disps.at(m-1) + counts.at(m-1);
+		}
+		replicated_agents_.resize(disps.back() + counts.back());
+		MPI_Allgatherv(local_replicated_agents.data(), local_count, MPI_UINT64_T,
+			replicated_agents_.data(), counts.data(), disps.data(), MPI_UINT64_T, MasterComm_);
+		std::sort(replicated_agents_.begin(), replicated_agents_.end());
+	}
+
+	// Dead agents are not replicated anymore
+	replicated_agents_.erase(std::remove_if(replicated_agents_.begin(), replicated_agents_.end(),
+		[this](AgentGlobalId agent) { return masters_.find(agent) == masters_.end(); }),
+		replicated_agents_.end());
+	replicas_offsets_.clear();
+	if (replicated_agents_.empty()) {
+		replicas_.clear();
+		return;
+	}
+
+	// The public structures are gathered in the order of their masters, then in
+	// the order of replicated_agents_
+	std::vector<int> sizes(nb_masters_, 0);
+	for (auto &agent : replicated_agents_) {
+		sizes.at(masters_.at(agent)) += public_attributes_struct_sizes_.at(GlobalToLocalType(agent));
+	}
+	std::vector<int> disps(nb_masters_, 0);
+	for (MasterId m=1; m<nb_masters_; m++) {
+		disps.at(m) = disps.at(m-1) + sizes.at(m-1);
+	}
+	std::vector<int> positions = disps;
+	std::vector<char> local_structs;
+	for (auto &agent : replicated_agents_) {
+		MasterId master = masters_.at(agent);
+		size_t size = public_attributes_struct_sizes_.at(GlobalToLocalType(agent));
+		replicas_offsets_.insert(std::make_pair(agent, positions.at(master)));
+		positions.at(master) += size;
+		if (master == id_) {
+			char* begin = static_cast<char*>(begin_public_window_) + public_agents_offsets_.at(agent);
+			local_structs.insert(local_structs.end(), begin, begin + size);
+		}
+	}
+	replicas_.resize(disps.back() + sizes.back());
+	MPI_Allgatherv(local_structs.data(), local_structs.size(), MPI_BYTE,
+		replicas_.data(), sizes.data(), disps.data(), MPI_BYTE, MasterComm_);
 }
 
 
@@ -695,16 +2237,56 @@ void Master::SendReceiveInteractions() {
 	int total_to_send = 0;
 	int total_to_receive = 0;
 	std::vector<int> nb_messages_to_send(nb_masters_*nb_interactions_);
-	std::vector<int> nb_messages_to_receive(nb_masters_*nb_interactions_);
+	std::vector<int> nb_messages_to_receive(nb_masters_*nb_interactions_, 0);
+	int fits_graph = (NeighborsComm_ != MPI_COMM_NULL);
 	for (int i=0; i<nb_masters_*nb_interactions_; i++) {
 		nb_messages_to_send.at(i) = interactions_to_send_.at(i).size();
 		total_to_send += nb_messages_to_send.at(i);
+		if (nb_messages_to_send.at(i) > 0 && !is_neighbor_.at(i/nb_interactions_)) {
+			fits_graph = 0;
+		}
+	}
+	auto time = std::chrono::steady_clock::now();
+	MPI_Allreduce(MPI_IN_PLACE, &fits_graph, 1, MPI_INT, MPI_LAND, MasterComm_);
+	time = Trace(0, "MPI_Allreduce", time);
+	if (fits_graph) {
+		ExchangeCountsWithNeighbors(nb_messages_to_send, nb_messages_to_receive);
+		time = Trace(0, "ExchangeCountsWithNeighbors", time);
+	} else {
+		ExchangeCountsSparse(nb_messages_to_send, nb_messages_to_receive);
+		time = Trace(0, "ExchangeCountsSparse", time);
 	}
-	MPI_Alltoall(nb_messages_to_send.data(), nb_interactions_, MPI_INT,
-		nb_messages_to_receive.data(), nb_interactions_, MPI_INT, MasterComm_);
 	for (int i=0; i<nb_masters_*nb_interactions_; i++) {
 		total_to_receive += nb_messages_to_receive.at(i);
+		if (nb_messages_to_send.at(i) > 0 || nb_messages_to_receive.at(i) > 0) {
+			observed_peers_.insert(i/nb_interactions_);
+		}
+	}
+
+	// The graph is extended with the new peers when it did not fit, and rebuilt
+	// from the observed peers only from time to time to forget the old ones
+	if (!fits_graph) {
+		std::set<MasterId> neighbors(neighbors_.begin(), neighbors_.end());
+		neighbors.insert(observed_peers_.begin(), observed_peers_.end());
+		BuildNeighborsGraph(neighbors);
+		time = Trace(0, "BuildNeighborsGraph", time);
+	} else if (step_%NEIGHBORS_PERIOD == 0) {
+		BuildNeighborsGraph(observed_peers_);
+		observed_peers_.clear();
+		time = Trace(0, "BuildNeighborsGraph", time);
+	}
+
+	for (int i=0; i<nb_masters_*nb_interactions_; i++) {
+		int size;
+		MPI_Type_size(interactions_MPI_types_.at(i%nb_interactions_), &size);
+		step_statistics_.bytes_sent += (double)size*nb_messages_to_send.at(i);
+		step_statistics_.bytes_received += (double)size*nb_messages_to_receive.at(i);
+		double* traffic = &step_traffic_.at(TrafficOffset(i/nb_interactions_));
+		traffic[i%nb_interactions_] += nb_messages_to_send.at(i);
+		traffic[nb_interactions_ + i%nb_interactions_] += (double)size*nb_messages_to_send.at(i);
 	}
+	step_statistics_.interactions_sent += total_to_send;
+	step_statistics_.interactions_received += total_to_receive;
 
 	std::vector<MPI_Request> requests(total_to_receive+total_to_send);
 
@@ -741,7 +2323,9 @@ void Master::SendReceiveInteractions() {
 		}
 	}
 
+	time = std::chrono::steady_clock::now();
 	MPI_Waitall(total_to_receive+total_to_send, requests.data(), MPI_STATUSES_IGNORE);
+	Trace(0, "MPI_Waitall", time);
 
 	for (int k=0; k<total_to_receive; k++) {
 		received_interactions_.push_back(Interaction::FromStruct(interactions_buffer_.pointer_to(k)));
@@ -754,66 +2338,521 @@ void Master::SendReceiveInteractions() {
 }
 
 
+void Master::ExchangeCountsWithNeighbors(std::vector<int> &nb_messages_to_send,
+	std::vector<int> &nb_messages_to_receive) {
+	size_t n = neighbors_.size();
+	std::vector<int> send_buffer(n*nb_interactions_);
+	std::vector<int> receive_buffer(n*nb_interactions_);
+	for (size_t k=0; k<n; k++) {
+		std::copy_n(nb_messages_to_send.begin() + neighbors_.at(k)*nb_interactions_, nb_interactions_,
+			send_buffer.begin() + k*nb_interactions_);
+	}
+	MPI_Neighbor_alltoall(send_buffer.data(), nb_interactions_, MPI_INT,
+		receive_buffer.data(), nb_interactions_, MPI_INT, NeighborsComm_);
+	for (size_t k=0; k<n; k++) {
+		std::copy_n(receive_buffer.begin() + k*nb_interactions_, nb_interactions_,
+			nb_messages_to_receive.begin() + neighbors_.at(k)*nb_interactions_);
+	}
+}
+
+
+void Master::ExchangeCountsSparse(std::vector<int> &nb_messages_to_send,
+	std::vector<int> &nb_messages_to_receive) {
+	const int counts_tag = 1;
+	std::vector<MPI_Request> send_requests;
+	for (MasterId m=0; m<nb_masters_; m++) {
+		auto begin = nb_messages_to_send.begin() + m*nb_interactions_;
+		if (std::any_of(begin, begin + nb_interactions_, [](int count) { return count > 0; })) {
+			send_requests.emplace_back();
+			MPI_Issend(&(*begin), nb_interactions_, MPI_INT, m, counts_tag, MasterComm_, &send_requests.back());
+		}
+	}
+	MPI_Request barrier_request;
+	bool barrier_started = false;
+	int done = 0;
+	while (!done) {
+		int arrived;
+		MPI_Status status;
+		MPI_Iprobe(MPI_ANY_SOURCE, counts_tag, MasterComm_, &arrived, &status);
+		if (arrived) {
+			MPI_Recv(nb_messages_to_receive.data() + status.MPI_SOURCE*nb_interactions_, nb_interactions_,
+				MPI_INT, status.MPI_SOURCE, counts_tag, MasterComm_, MPI_STATUS_IGNORE);
+		}
+		if (barrier_started) {
+			MPI_Test(&barrier_request, &done, MPI_STATUS_IGNORE);
+		} else {
+			int sent;
+			MPI_Testall(send_requests.size(), send_requests.data(), &sent, MPI_STATUSES_IGNORE);
+			if (sent) {
+				MPI_Ibarrier(MasterComm_, &barrier_request);
+				barrier_started = true;
+			}
+		}
+	}
+}
+
+
+void Master::BuildNeighborsGraph(std::set<MasterId> &neighbors) {
+	if (NeighborsComm_ != MPI_COMM_NULL) {
+		MPI_Comm_free(&NeighborsComm_);
+	}
+	for (auto &m : neighbors_) {
+		is_neighbor_.at(m) = false;
+	}
+	neighbors_.assign(neighbors.begin(), neighbors.end());
+	for (auto &m : neighbors_) {
+		is_neighbor_.at(m) = true;
+	}
+	MPI_Dist_graph_create_adjacent(MasterComm_, neighbors_.size(), neighbors_.data(), MPI_UNWEIGHTED,
+		neighbors_.size(), neighbors_.data(), MPI_UNWEIGHTED, MPI_INFO_NULL, 0, &NeighborsComm_);
+}
+
+
 void Master::MetaEvolution() {
-	// Will read AgentsToDelete and AgentsToCreate to fill
-	// LocalMetaEvolutionDescriptions with the associated evolutions.
-	auto lock = AgentsToDelete.unique_lock();
-	for(auto AgentId: AgentsToDelete.raw()) {
-		MetaEvolutionDescription _desc = MetaEvolutionDescription();
-		// Initialisation
-		_desc.type = AgentEvolution::Death;
-		_desc.agent_id = AgentId;
-		_desc.origin_id = id_;
-		_desc.destination_id = 0;
-		_desc.private_overhead = 0;
-		LocalMetaEvolutionDescriptions.push_back(_desc);
-	}
-	lock.unlock();
+	LocalMetaEvolutionDescriptions.clear();
+
+	// Deaths and births staged by the agent handlers during the previous time
+	// step
+	std::unordered_set<AgentGlobalId> dying;
+	for (auto &agent_handler : agent_handlers_) {
+		for (auto &agent : agent_handler.dead_agents) {
+			AgentGlobalId global_id = LocalToGlobalId(agent.first, agent.second);
+			dying.insert(global_id);
+			MetaEvolutionDescription description = MetaEvolutionDescription();
+			description.type = AgentEvolution::Death;
+			description.agent_id = global_id;
+			description.origin_id = id_;
+			description.destination_id = id_;
+			description.private_overhead = 0;
+			LocalMetaEvolutionDescriptions.push_back(description);
+		}
+		for (auto &agent : agent_handler.born_agents) {
+			MetaEvolutionDescription description = MetaEvolutionDescription();
+			description.type = AgentEvolution::Birth;
+			description.agent_id = LocalToGlobalId(agent->id_, agent->type_);
+			description.origin_id = id_;
+			description.destination_id = id_;
+			description.private_overhead = 0;
+			LocalMetaEvolutionDescriptions.push_back(description);
+		}
+	}
 
 	// Will then call heuristics:MigrateAgents to continue filling
-	// this very same vector with the migrations needed.
-	MigrateAgents();
+	// this very same vector with the migrations needed, and resets the traffic
+	// counters for the next migration round
+	if (step_%MIGRATION_PERIOD == 0) {
+		std::vector<std::pair<AgentGlobalId, TrafficCounters>> traffics;
+		for (auto &agent : agents_) {
+			if (IsAgentSendable(GlobalToLocalType(agent.first)) && dying.count(agent.first) == 0) {
+				traffics.emplace_back(agent.first, std::move(agent.second->traffic_));
+			}
+			agent.second->traffic_ = TrafficCounters();
+		}
+		MigrateAgents(id_, step_/MIGRATION_PERIOD, traffics, nb_agents_by_master_, LocalMetaEvolutionDescriptions);
+	}
+
 	// Use a MPI_Allgather to exchange the number of meta evolution on each
 	// master
+	std::vector<int> meta_evolutions_count(nb_masters_);
+	int local_count = LocalMetaEvolutionDescriptions.size();
+	MPI_Allgather(&local_count, 1, MPI_INT, meta_evolutions_count.data(), 1, MPI_INT, MasterComm_);
+
+	// After that, use MPI_Allgatherv to exchange the meta evolutions with all
+	// the masters and put them in a global vector (in the order of the masters)
+	std::vector<int> disps(nb_masters_, 0);
+	for (MasterId m=1; m<nb_masters_; m++) {
+		disps.at(m) = disps.at(m-1) + meta_evolutions_count.at(m-1);
+	}
+	size_t total_count = disps.back() + meta_evolutions_count.back();
+	if (total_count == 0) {
+		return;
+	}
+	GlobalMetaEvolutionDescriptions.resize(total_count);
+	MPI_Allgatherv(LocalMetaEvolutionDescriptions.data(), local_count, MetaEvolutionDescriptionMPIDatatype,
+		GlobalMetaEvolutionDescriptions.data(), meta_evolutions_count.data(), disps.data(),
+		MetaEvolutionDescriptionMPIDatatype, MasterComm_);
 
-        int *MetaEvolutionsCount = (int*) calloc(nb_masters_, sizeof(int));
-        int LocalCount = LocalMetaEvolutionDescriptions.size();
-        MPI_Allgather(&LocalCount, 1, MPI_INT, MetaEvolutionsCount, 1, MPI_INT, MasterComm_);
-        // Now, MetaEvolutionsCount is an array containing, for each master, the number of MetaEvolution it has to send
-	// After that, use MPI_Allgatherv to exchange (number obtained at the previous step)
-	// the meta evolutions with all the masters and put them in a Global Vector
-
-        int sum=0;
-        for(int i=0; i< nb_masters_; ++i) {
-                sum+=MetaEvolutionsCount[i];
-        }
-
-		// TODO: Verify the following (before: sizeof(int), sum)
-        int *disps = (int *) calloc(sizeof(int), nb_masters_);
-        disps[0]=0;
-        for(int i=1; i< nb_masters_; ++i) {
-                disps[i]=disps[i-1]+MetaEvolutionsCount[i];
-        }
-
-	GlobalMetaEvolutionDescriptions.resize(sum);
-	// FIXME: try the evolution in place in the local vector
-        MPI_Allgatherv(LocalMetaEvolutionDescriptions.data(), LocalMetaEvolutionDescriptions.size(), MetaEvolutionDescriptionMPIDatatype, (GlobalMetaEvolutionDescriptions.data()), MetaEvolutionsCount, disps, MetaEvolutionDescriptionMPIDatatype, MasterComm_);
 	// Then use all the meta evolutions to actually migrate agents, pop them on
-	// our local master or on another master, and destruct the agents that died.
+	// our local master, and destruct the agents that died
+	ApplyMetaEvolutions();
+}
+
+
+void Master::ApplyMetaEvolutions() {
+	// Updating the directory, the identifiers and the windows offsets, in the
+	// same order on all masters
+	std::vector<AgentGlobalId> deaths;
+	std::vector<AgentGlobalId> departures;
+	std::vector<AgentGlobalId> arrivals;
+	std::vector<MasterId> origins;
+	std::vector<AgentId> previous_maximal_ids = maximal_ids_;
+	bool moved_or_died = false;
+	for (auto &description : GlobalMetaEvolutionDescriptions) {
+		AgentGlobalId global_id = description.agent_id;
+		AgentType type = GlobalToLocalType(global_id);
+		AgentId id = GlobalToLocalId(global_id);
+		switch (description.type) {
+			case AgentEvolution::Death:
+				FreePublicSlot(description.origin_id, type, public_agents_offsets_.at(global_id));
+				FreeCriticalSlot(type, critical_agents_offsets_.at(global_id));
+				public_agents_offsets_.erase(global_id);
+				critical_agents_offsets_.erase(global_id);
+				masters_.erase(global_id);
+				agent_ids_by_types_.at(type).erase(id);
+				nb_agents_by_master_.at(description.origin_id)--;
+				if (description.origin_id == id_) {
+					deaths.push_back(global_id);
+				}
+				moved_or_died = true;
+				break;
+			case AgentEvolution::Migration:
+				FreePublicSlot(description.origin_id, type, public_agents_offsets_.at(global_id));
+				public_agents_offsets_.at(global_id) = AllocatePublicSlot(description.destination_id, type);
+				masters_.at(global_id) = description.destination_id;
+				nb_agents_by_master_.at(description.origin_id)--;
+				nb_agents_by_master_.at(description.destination_id)++;
+				if (description.origin_id == id_) {
+					departures.push_back(global_id);
+				} else if (description.destination_id == id_) {
+					arrivals.push_back(global_id);
+					origins.push_back(description.origin_id);
+				}
+				moved_or_died = true;
+				break;
+			case AgentEvolution::Birth:
+				public_agents_offsets_[global_id] = AllocatePublicSlot(description.destination_id, type);
+				critical_agents_offsets_[global_id] = AllocateCriticalSlot(type);
+				masters_[global_id] = description.destination_id;
+				agent_ids_by_types_.at(type).insert(id);
+				maximal_ids_.at(type) = std::max(maximal_ids_.at(type), id+1);
+				nb_agents_by_master_.at(description.destination_id)++;
+				break;
+		}
+	}
+	RecycleFreshIds(previous_maximal_ids);
+	GrowWindows();
+
+	// Removing the dead agents, whose identifiers can be given to new agents
+	// of the same agent handler
+	for (auto &global_id : deaths) {
+		auto key = std::make_pair(GlobalToLocalId(global_id), GlobalToLocalType(global_id));
+		for (auto &agent_handler : agent_handlers_) {
+			if (agent_handler.agents.find(key) != agent_handler.agents.end()) {
+				agent_handler.DeleteAgent(key.first, key.second);
+				agent_handler.free_ids[key.second].push_back(key.first);
+				break;
+			}
+		}
+		agents_.erase(global_id);
+	}
+
+	// Sending and receiving the migrating agents
+	std::vector<MPI_Request> requests(departures.size() + arrivals.size());
+	for (size_t k=0; k<departures.size(); k++) {
+		Agent* agent = agents_.at(departures.at(k));
+		agent->CreateStruct();
+		MPI_Isend(agent->structure_, 1, agents_MPI_types_.at(agent->type_),
+			masters_.at(departures.at(k)), 0, MasterComm_, &requests.at(k));
+	}
+	utils::fixed_size_multibuffer<AgentStruct> received_agents(max_agent_size_, arrivals.size());
+	for (size_t k=0; k<arrivals.size(); k++) {
+		MPI_Irecv(received_agents.pointer_to(k), 1, agents_MPI_types_.at(GlobalToLocalType(arrivals.at(k))),
+			origins.at(k), 0, MasterComm_, &requests.at(departures.size()+k));
+	}
+	MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+
+	for (auto &global_id : departures) {
+		RemoveAgent(global_id);
+	}
+
+	// Adding the arrived agents to the least loaded agent handlers, and copying
+	// their public attributes in their new slot
+	for (size_t k=0; k<arrivals.size(); k++) {
+		size_t least_loaded = 0;
+		for (size_t i=1; i<agent_handlers_.size(); i++) {
+			if (agent_handlers_.at(i).agents.size() < agent_handlers_.at(least_loaded).agents.size()) {
+				least_loaded = i;
+			}
+		}
+		AddAgent(agent_handlers_.at(least_loaded), received_agents.pointer_to(k));
+		void* public_location = static_cast<char*>(begin_public_window_) + public_agents_offsets_.at(arrivals.at(k));
+		agents_.at(arrivals.at(k))->CopyPublicAttributes(public_location);
+	}
+
+	// Adding the new agents to the agent handlers of their parents; all their
+	// critical attributes are marked as updated so that UpdateAllPublicAttributes
+	// sends them to all masters
+	for (auto &agent_handler : agent_handlers_) {
+		for (auto &agent : agent_handler.born_agents) {
+			AgentGlobalId global_id = LocalToGlobalId(agent->id_, agent->type_);
+			for (auto &critical : critical_attributes_) {
+				if (critical.first == agent->type_) {
+					agent->updated_critical_attributes_.push_back(critical.second);
+				}
+			}
+			agents_.insert(std::make_pair(global_id, agent_handler.AddAgent(std::move(agent))));
+		}
+		agent_handler.born_agents.clear();
+		agent_handler.dead_agents.clear();
+	}
+
+	if (moved_or_died) {
+		RedirectInteractions();
+	}
+}
+
+
+void Master::RecycleFreshIds(std::vector<AgentId> &previous_maximal_ids) {
+	size_t k = 0;
+	for (AgentType type=0; type<nb_types_; type++) {
+		// Fresh identifiers of this master between the previous and the new
+		// bound which were not given
+		AgentId id = previous_maximal_ids.at(type) + id_ + nb_masters_*fresh_ids_.at(type).load();
+		for (; id < maximal_ids_.at(type); id += nb_masters_) {
+			agent_handlers_.at(k%agent_handlers_.size()).free_ids[type].push_back(id);
+			k++;
+		}
+		fresh_ids_.at(type).store(0);
+	}
+}
+
+
+void Master::BalanceAgentHandlers() {
+	if (agent_handlers_.size() >= 2) {
+		ResizeAgentHandlers(agent_handlers_.size());
+	}
+}
+
+
+void Master::ResizeAgentHandlers(size_t nb_agent_handlers) {
+	size_t previous_nb_agent_handlers = agent_handlers_.size();
+	while (agent_handlers_.size() < nb_agent_handlers) {
+		agent_handlers_.emplace_back(id_, *this);
+	}
+
+	std::vector<Agent*> agents;
+	std::vector<double> costs;
+	std::vector<size_t> assignment;
+	std::vector<size_t> orphans;
+	for (size_t i=0; i<previous_nb_agent_handlers; i++) {
+		for (auto &agent : agent_handlers_.at(i).agents) {
+			if (i >= nb_agent_handlers) {
+				orphans.push_back(agents.size());
+			}
+			agents.push_back(agent.second.get());
+			costs.push_back(agent.second->behavior_cost_);
+			assignment.push_back(i);
+		}
+	}
+
+	// The agents of the removed agent handlers are first given, the most
+	// costly first, to the least loaded remaining agent handler
+	std::vector<size_t> new_assignment = assignment;
+	std::vector<double> loads(nb_agent_handlers, 0);
+	for (size_t k=0; k<agents.size(); k++) {
+		if (assignment.at(k) < nb_agent_handlers) {
+			loads.at(assignment.at(k)) += costs.at(k);
+		}
+	}
+	std::sort(orphans.begin(), orphans.end(), [&costs](size_t a, size_t b) {
+		return costs.at(a) > costs.at(b);
+	});
+	for (auto &k : orphans) {
+		size_t least_loaded = std::min_element(loads.begin(), loads.end()) - loads.begin();
+		new_assignment.at(k) = least_loaded;
+		loads.at(least_loaded) += costs.at(k);
+	}
+	RebalanceAgentHandlers(costs, new_assignment, nb_agent_handlers);
+	for (size_t k=0; k<agents.size(); k++) {
+		if (new_assignment.at(k) != assignment.at(k)) {
+			// The agent itself does not move, so agents_ stays valid
+			agent_handlers_.at(new_assignment.at(k)).AddAgent(
+				agent_handlers_.at(assignment.at(k)).ExtractAgent(agents.at(k)->id_, agents.at(k)->type_));
+		}
+	}
+
+	// The births, deaths and free identifiers staged by the removed agent
+	// handlers are kept by the first one
+	AgentHandler &first = agent_handlers_.at(0);
+	for (size_t i=nb_agent_handlers; i<agent_handlers_.size(); i++) {
+		AgentHandler &removed = agent_handlers_.at(i);
+		for (auto &agent : removed.born_agents) {
+			first.born_agents.push_back(std::move(agent));
+		}
+		first.dead_agents.insert(first.dead_agents.end(), removed.dead_agents.begin(), removed.dead_agents.end());
+		for (auto &ids : removed.free_ids) {
+			first.free_ids[ids.first].insert(first.free_ids[ids.first].end(), ids.second.begin(), ids.second.end());
+		}
+	}
+	while (agent_handlers_.size() > nb_agent_handlers) {
+		agent_handlers_.pop_back();
+	}
+
+	// The agent handlers may have been moved in memory
+	for (auto &agent_handler : agent_handlers_) {
+		for (auto &agent : agent_handler.agents) {
+			agent.second->handler_ = &agent_handler;
+		}
+		for (auto &agent : agent_handler.born_agents) {
+			agent->handler_ = &agent_handler;
+		}
+	}
+}
+
+
+void Master::ChangeNbAgentHandlers(int nb_agent_handlers) {
+	if (id_ == 0) {
+		// This method is a control method, so sends orders from master 0 to other
+		// masters
+		order_ = Order::CHANGE_NB_AGENT_HANDLERS;
+		IdleBcast(&order_, 1, MPI_INT, 0, MasterComm_);
+	}
+	// Receives the new number of agent handlers from master 0
+	MPI_Bcast(&nb_agent_handlers, 1, MPI_INT, 0, MasterComm_);
+	auto_agent_handlers_ = (nb_agent_handlers == AUTO_AGENT_HANDLERS);
+	agent_handlers_times_.clear();
+	agent_handlers_time_ = 0;
+	agent_handlers_measured_steps_ = 0;
+	if (!auto_agent_handlers_) {
+		ResizeAgentHandlers(nb_agent_handlers);
+	}
+}
+
+
+void Master::AdaptNbAgentHandlers() {
+	size_t current = agent_handlers_.size();
+	agent_handlers_times_[current] = agent_handlers_time_/agent_handlers_measured_steps_;
+	agent_handlers_time_ = 0;
+	agent_handlers_measured_steps_ = 0;
+	// The cores of the node are shared by its masters, each keeping one for its
+	// communication thread
+	int node_size;
+	MPI_Comm_size(NodeComm_, &node_size);
+	size_t cores_per_master = std::thread::hardware_concurrency()/node_size;
+	size_t max_nb_agent_handlers = cores_per_master > 1 ? cores_per_master - 1 : 1;
+	size_t next = ChooseNbAgentHandlers(agent_handlers_times_, current, max_nb_agent_handlers);
+	if (++auto_agent_handlers_rounds_%AUTO_HANDLERS_EXPLORATION == 0) {
+		agent_handlers_times_.clear();
+	}
+	if (next != current) {
+		ResizeAgentHandlers(next);
+	}
+}
+
+
+void Master::RedirectInteractions() {
+	for (MasterId m=0; m<nb_masters_; m++) {
+		for (InteractionType type=0; type<nb_interactions_; type++) {
+			auto &queue = interactions_to_send_.at(m*nb_interactions_+type).raw();
+			size_t kept = 0;
+			for (size_t k=0; k<queue.size(); k++) {
+				AgentGlobalId recipient = LocalToGlobalId(queue.at(k)->recipient_id_, queue.at(k)->recipient_type_);
+				auto recipient_master_it = masters_.find(recipient);
+				if (recipient_master_it == masters_.end()) {
+					continue;
+				}
+				MasterId recipient_master = recipient_master_it->second;
+				if (recipient_master == m) {
+					queue.at(kept++) = std::move(queue.at(k));
+				} else {
+					interactions_to_send_.at(recipient_master*nb_interactions_+type).raw().push_back(std::move(queue.at(k)));
+				}
+			}
+			queue.resize(kept);
+		}
+	}
 }
 
 
 void Master::RunTimeStep() {
 	step_++;
+	auto time = std::chrono::steady_clock::now();
 	// TODO: updating environments
-	UpdateAllPublicAttributes();
+	MetaEvolution();
+	time = TimePhase(Phase::META_EVOLUTION, time);
 	Synchronize();
-	//MetaEvolution();
+	time = TimeSynchronization(SyncPoint::AFTER_META_EVOLUTION, time);
+	UpdateAllPublicAttributes();
+	time = TimePhase(Phase::UPDATE_PUBLIC_ATTRIBUTES, time);
 	Synchronize();
+	time = TimeSynchronization(SyncPoint::AFTER_UPDATE_PUBLIC_ATTRIBUTES, time);
+	ReplicatePublicAttributes();
+	time = TimePhase(Phase::REPLICATION, time);
 	SendReceiveInteractions();
+	time = TimePhase(Phase::SEND_RECEIVE_INTERACTIONS, time);
 	Synchronize();
+	time = TimeSynchronization(SyncPoint::AFTER_SEND_RECEIVE_INTERACTIONS, time);
 	DistributeReceivedInteractions();
+	time = TimePhase(Phase::DISTRIBUTE_INTERACTIONS, time);
 	Synchronize();
+	time = TimeSynchronization(SyncPoint::AFTER_DISTRIBUTE_INTERACTIONS, time);
 	RunBehaviors();
+	time = TimePhase(Phase::BEHAVIORS, time);
+	if (auto_agent_handlers_) {
+		// Only the phases executed by the agent handlers are measured
+		agent_handlers_time_ += step_statistics_.phases[static_cast<size_t>(Phase::UPDATE_PUBLIC_ATTRIBUTES)]
+			+ step_statistics_.phases[static_cast<size_t>(Phase::BEHAVIORS)];
+		if (++agent_handlers_measured_steps_ == AUTO_HANDLERS_PERIOD) {
+			AdaptNbAgentHandlers();
+		}
+	}
+	if (step_%HANDLERS_BALANCING_PERIOD == 0) {
+		BalanceAgentHandlers();
+	}
+	time = TimePhase(Phase::BALANCING, time);
+	if (!probes_.empty()) {
+		EvaluateProbes();
+		time = TimePhase(Phase::PROBES, time);
+	}
 	Synchronize();
+	TimeSynchronization(SyncPoint::END_OF_STEP, time);
+
+	statistics_.at((step_-1)%STATISTICS_WINDOW) = step_statistics_;
+	step_statistics_ = StepStatistics();
+	traffic_.at((step_-1)%TRAFFIC_WINDOW).swap(step_traffic_);
+	std::fill(step_traffic_.begin(), step_traffic_.end(), 0.);
+	if (attributes_profiling_) {
+		attributes_profile_steps_++;
+		profiled_remote_agents_.clear();
+	}
+}
+
+
+std::unordered_map<AgentType, size_t> Master::AgentStructsSizes() {
+	std::unordered_map<AgentType, size_t> structs_sizes;
+	for (auto &type : agents_MPI_types_) {
+		MPI_Aint lower_bound, extent;
+		MPI_Type_get_true_extent(type.second, &lower_bound, &extent);
+		structs_sizes[type.first] = lower_bound + extent;
+	}
+	return structs_sizes;
+}
+
+
+std::chrono::steady_clock::time_point Master::TimePhase(Phase phase, std::chrono::steady_clock::time_point start) {
+	auto end = Trace(0, PHASES_NAMES[static_cast<size_t>(phase)], start);
+	std::chrono::duration<double> elapsed = end - start;
+	step_statistics_.phases[static_cast<size_t>(phase)] += elapsed.count();
+	return end;
+}
+
+
+std::chrono::steady_clock::time_point Master::TimeSynchronization(SyncPoint point, std::chrono::steady_clock::time_point start) {
+	auto end = TimePhase(Phase::SYNCHRONIZATION, start);
+	std::chrono::duration<double> elapsed = end - start;
+	step_statistics_.synchronizations[static_cast<size_t>(point)] += elapsed.count();
+	return end;
+}
+
+
+std::chrono::steady_clock::time_point Master::Trace(size_t thread, const char* name, std::chrono::steady_clock::time_point begin) {
+	auto end = std::chrono::steady_clock::now();
+	if (tracing_) {
+		TraceEvent event;
+		event.name = name;
+		event.begin = begin;
+		event.end = end;
+		trace_buffers_.at(thread).push(event);
+	}
+	return end;
 }
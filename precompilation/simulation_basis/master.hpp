@@ -9,8 +9,13 @@
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
+#include <set>
+#include <map>
 #include <limits>
 #include <thread>
+#include <atomic>
+#include <chrono>
+#include <fstream>
 #include <mpi.h>
 
 #include "types.hpp"
@@ -59,11 +64,10 @@
  * broadcast, which they will receive while they are in WaitOrderFromRoot.
  *
  * \warning The creation and operation on masters must be handled between calls
- *          to MPI_Init_thread and MPI_Finalize.
+ *          to MPI_Init_thread and MPI_Finalize, by the thread which called
+ *          MPI_Init_thread (at least MPI_THREAD_FUNNELED is required): it is
+ *          the only thread of the master which makes MPI calls.
  *
- * \todo TODO Implement AddUserAgents.
- * \todo TODO Migration, birth and death of agents.
- * \todo TODO Decide when an agent should migrate.
  * \todo TODO Define and implement environments.
  * \todo TODO Check the correctness of the code on several platforms
  *       (especially Windows).
@@ -82,6 +86,9 @@ class Master {
 		/// Order used to run the simulation for some number of steps.
 		RUN_SIMULATION,
 
+		/// Order used to run the simulation for several periods at once.
+		RUN_BATCH,
+
 		/// Order used to modify the number of steps in RunSimulation.
 		CHANGE_PERIOD,
 
@@ -92,33 +99,84 @@ class Master {
 		/// private).
 		MODIFY_ATTRIBUTE,
 
+		/// Order used to modify several attributes at once.
+		MODIFY_ATTRIBUTES,
+
 		/// Order used to specify that master 0 should gather relevant infos
 		/// about the simulation and export them.
 		EXPORT_SIMULATION,
 
+		/// Order used to snapshot the simulation and export it in the
+		/// background.
+		EXPORT_SIMULATION_ASYNC,
+
+		/// Order used to send the json representation of an agent to master 0.
+		GET_AGENT,
+
+		/// Order used to aggregate an attribute of all the agents of a type.
+		AGGREGATE,
+
+		/// Order used to add a probe to the simulation.
+		ADD_PROBE,
+
+		/// Order used to remove all the probes of the simulation.
+		CLEAR_PROBES,
+
+		/// Order used to change the number of agent handlers of each master.
+		CHANGE_NB_AGENT_HANDLERS,
+
+		/// Order used to gather the performance statistics of the masters.
+		STATISTICS,
+
+		/// Order used to compute the distribution of the times of the phases.
+		PHASE_TIMINGS,
+
+		/// Order used to gather the traffic between the masters.
+		TRAFFIC_MATRIX,
+
+		/// Order used to enable or disable the attributes access profiling.
+		ATTRIBUTES_PROFILING,
+
+		/// Order used to gather the attributes access profile.
+		ATTRIBUTES_PROFILE,
+
+		/// Order used to enable or disable the tracing mode.
+		TRACING,
+
+		/// Order used to gather the recorded trace events and write them.
+		DUMP_TRACE,
+
 		/// Order used to pause the simulation.
 		IDLE
 	};
 
 public:
+	/// Value given to ChangeNbAgentHandlers to enable the automatic choice of
+	/// the number of agent handlers.
+	static const int AUTO_AGENT_HANDLERS = 0;
+
 
 	/**
-	 * \fn Master (MasterId id_, MasterId nb_masters_, int nb_threads, std::vector<void*> &initial_agents)
+	 * \fn Master (MasterId id_, MasterId nb_masters_, int nb_threads, std::vector<void*> &initial_agents,
+	 *             const PlacementDescription &placement)
 	 * \brief Constructor of Master, which initializes the parameters of the
 	 *        simulation as well as randomness.
 	 * \param id Identifier and MPI rank of the created master.
 	 * \param nb_masters Number of masters used in the simulation.
 	 * \param initial_agents Reference to the vector of pointers to AgentStructs
 	 *        representing the initial agents.
+	 * \param placement Description of the interaction graph of the initial
+	 *        agents, used to choose their masters.
 	 *
-	 * \attention initial_agents is only useful for master 0; all other should
-	 * receive an empty vector.
+	 * \attention initial_agents and placement are only useful for master 0;
+	 * all other should receive empty ones.
 	 *
 	 * \attention If an agent has been initialized with a non trivial non
 	 * sendable parameter, then, if it is moved to another master, this
 	 * parameter will be set to its default value (empty vector, for example).
 	 */
-	Master (MasterId id, MasterId nb_masters, int nb_threads, std::vector<void*> &initial_agents);
+	Master (MasterId id, MasterId nb_masters, int nb_threads, std::vector<void*> &initial_agents,
+		const PlacementDescription &placement = PlacementDescription());
 
 	/**
 	 * \fn ~Master()
@@ -196,13 +254,27 @@ public:
 	void* GetConstant(std::string constant);
 
 	/**
-	 * \fn void* GetAttribute(Attribute attr, AgentId recipient_id, AgentType recipient_type)
+	 * \fn AgentId FreshAgentId(AgentType type)
+	 * \brief Gives an identifier of type type never used in the simulation.
+	 * \param type Type identifier of the new agent.
+	 * \return The local identifier of the new agent.
+	 * \details The identifiers given by master m during a time step are
+	 * AgentIdTypeBound(type) + m + k*nb_masters, so that masters never give the
+	 * same identifier without communicating. Thread-safe.
+	 */
+	AgentId FreshAgentId(AgentType type);
+
+	/**
+	 * \fn void* GetAttribute(Attribute attr, AgentId recipient_id, AgentType recipient_type,
+	 *                         Agent* reader = nullptr)
 	 * \brief Computes a public attribute request from an agent.
 	 * \param attr Attribute identifier of the requested attribute.
 	 * \param recipient_id Local identifier of the agent which holds the
 	 *        requested attribute.
 	 * \param recipient_type Type identifier of the agent which holds the
 	 *        requested attribute.
+	 * \param reader Pointer to the agent asking for the attribute, whose
+	 *        traffic is counted for migrations (nullptr if unknown).
 	 * \return The pointer to the memory location where the value of the
 	 *         requested attribute is stored if the input agent exists.
 	 * \details Returns the memory location where the value of public attribute
@@ -214,7 +286,7 @@ public:
 	 *       exist.
 	 * \warning The value pointed by the returned pointer must not be modified.
 	 */
-	void* GetAttribute(Attribute attr, AgentId recipient_id, AgentType recipient_type);
+	void* GetAttribute(Attribute attr, AgentId recipient_id, AgentType recipient_type, Agent* reader = nullptr);
 
 	/**
 	 * \fn void UpdateCriticalAttribute(Attribute attr, AgentId agent_id, AgentType agent_type, void *location)
@@ -226,6 +298,8 @@ public:
 	 *        update.
 	 * \param location Pointer to the memory location where attribute attr is
 	 *        stored.
+	 * \details The puts are submitted to the communication thread, so location
+	 * must stay valid until the end of UpdateAllPublicAttributes.
 	 */
 	void UpdateCriticalAttribute(Attribute attr, AgentId agent_id, AgentType agent_type, void *location);
 
@@ -249,6 +323,18 @@ public:
 	 */
 	void RunSimulation();
 
+	/**
+	 * \fn void RunBatch(Time nb_periods)
+	 * \brief Runs nb_periods times RunSimulation, with a single order sent to
+	 *        the other masters.
+	 * \param nb_periods The number of periods to run.
+	 * \note The argument nb_periods is only relevant for master 0.
+	 * \note RunBatch is a control method.
+	 * \warning This function must only be externally called on master 0, while
+	 *          other masters are in WaitOrderFromRoot.
+	 */
+	void RunBatch(Time nb_periods = 0);
+
 	/**
 	 * \fn void ChangePeriod(Time new_period)
 	 * \brief Modifies the period_ of master 0 to new_period, and sends it to
@@ -262,15 +348,38 @@ public:
 	void ChangePeriod(Time new_period = 0);
 
 	/**
-	 * \fn void AddUserAgents(std::vector<void*> &new_agents)
+	 * \fn void ChangeNbAgentHandlers(int nb_agent_handlers)
+	 * \brief Sets the number of agent handlers (threads) of every master to
+	 *        the nb_agent_handlers of master 0, without stopping the simulation.
+	 * \param nb_agent_handlers The new number of agent handlers, or
+	 *        AUTO_AGENT_HANDLERS to let each master choose it from the measured
+	 *        durations of its time steps.
+	 * \note The argument nb_agent_handlers is only relevant for master 0.
+	 * \note ChangeNbAgentHandlers is a control method.
+	 * \warning This function must only be externally called on master 0, while
+	 *          other masters are in WaitOrderFromRoot.
+	 */
+	void ChangeNbAgentHandlers(int nb_agent_handlers = AUTO_AGENT_HANDLERS);
+
+	/**
+	 * \fn ubjson::Value AddUserAgents(std::vector<void*> &new_agents)
 	 * \brief Orders the other masters to add some agents to the simulation.
-	 * \param new_agents Reference to a vector of pointers to the agents to add.
-	 * \note RunSimulation is a control method.
-	 * \note The argument new_agents is only relevant for master 0.
+	 * \param new_agents Reference to a vector of pointers to the structures of
+	 *        the agents to add, as returned by Instanciate.
+	 * \return A map associating to the name of each agent type the local
+	 *         identifiers given to the new agents of this type.
+	 * \details Each agent is sent to the master holding the fewest agents (or
+	 * kept by master 0 if its type is not sendable), which gives it a fresh
+	 * identifier and stages it as a birth: the new agents take part in the
+	 * simulation from the next time step. The identifiers of the structures
+	 * are ignored.
+	 * \note AddUserAgents is a control method.
+	 * \remark The returned value and the argument new_agents are only relevant
+	 *         for master 0.
 	 * \warning This function must only be externally called on master 0, while
 	 *          other masters are in WaitOrderFromRoot.
 	 */
-	void AddUserAgents(std::vector<void*> &new_agents);
+	ubjson::Value AddUserAgents(std::vector<void*> &new_agents);
 
 	/**
 	 * \fn void ModifyAttribute(Attribute attr, AgentId agent_id, AgentType agent_type, void* location)
@@ -291,6 +400,24 @@ public:
 	 */
 	void ModifyAttribute(Attribute attr = 0, AgentId agent_id = 0, AgentType agent_type = 0, void* location = nullptr);
 
+	/**
+	 * \fn size_t ModifyAttributes(const std::vector<AttributeModification> &modifications)
+	 * \brief Modifies numerical attributes of several agents with a single
+	 *        order, as successive calls to ModifyAttribute would.
+	 * \param modifications Reference to the new values of the attributes,
+	 *        given as text.
+	 * \return The number of attributes modified.
+	 * \details Invalid modifications (unknown agent, non numerical attribute or
+	 * invalid value) are reported and skipped by master 0, which broadcasts the
+	 * other ones; each master then modifies the attributes of its agents.
+	 * \note ModifyAttributes is a control method.
+	 * \remark The returned value and the argument are only relevant for master
+	 *         0.
+	 * \warning This function must only be externally called on master 0, while
+	 *          other masters are in WaitOrderFromRoot.
+	 */
+	size_t ModifyAttributes(const std::vector<AttributeModification> &modifications = {});
+
 	/**
 	 * \fn ubjson::Value ExportSimulation()
 	 * \brief Handles the export of the simulation in a json format.
@@ -304,6 +431,257 @@ public:
 	 */
 	ubjson::Value ExportSimulation();
 
+	/**
+	 * \fn bool ExportSimulationAsync(std::string file)
+	 * \brief Exports the current state of the simulation to file in the json
+	 *        format of ExportSimulation, without stopping the simulation during
+	 *        the conversion and the writing.
+	 * \param file Path of the written file.
+	 * \return Whether file could be opened; otherwise no order is sent.
+	 * \details Each master copies the sendable attributes of its agents with
+	 * CreateStruct, and the copies are gathered on master 0. A thread of master
+	 * 0 then converts them to json and writes file while the simulation goes
+	 * on. An export waits for the previous one to be written.
+	 * \note The argument file is only relevant for master 0.
+	 * \note ExportSimulationAsync is a control method.
+	 * \remark The returned value is only significant for master 0.
+	 * \warning This function must only be externally called on master 0, while
+	 *          other masters are in WaitOrderFromRoot.
+	 */
+	bool ExportSimulationAsync(std::string file = "");
+
+	/**
+	 * \fn ubjson::Value GetAgentJsonNode(AgentId agent_id, AgentType agent_type)
+	 * \brief Returns on master 0 the json representation of an agent, as in
+	 *        ExportSimulation.
+	 * \param agent_id Local identifier of the agent.
+	 * \param agent_type Type identifier of the agent.
+	 * \return The value returned by GetJsonNode for the agent, or a null value
+	 *         if it does not exist.
+	 * \details The master of the agent is found in the directory, and only this
+	 * master sends the representation of the agent to master 0.
+	 * \note GetAgentJsonNode is a control method.
+	 * \remark The returned value and the arguments are only significant for
+	 *         master 0.
+	 * \warning This function must only be externally called on master 0, while
+	 *          other masters are in WaitOrderFromRoot.
+	 */
+	ubjson::Value GetAgentJsonNode(AgentId agent_id = 0, AgentType agent_type = 0);
+
+	/**
+	 * \fn ubjson::Value Aggregate(AgentType agent_type, Attribute attr, Aggregation op, size_t nb_bins)
+	 * \brief Computes on master 0 an aggregation of a numerical attribute over
+	 *        all the agents of a type, without exporting them.
+	 * \param agent_type Type identifier of the aggregated agents.
+	 * \param attr Attribute identifier of the aggregated attribute.
+	 * \param op Aggregation to compute.
+	 * \param nb_bins Number of bins of the histogram, evenly splitting the
+	 *        range of the values (only used by Aggregation::HISTOGRAM).
+	 * \return A map with the names of the type and of the attribute, the
+	 * number of agents ("count") and the result of op, named as in
+	 * AGGREGATIONS_NAMES, or a null value if the attribute is not numerical.
+	 * The histogram gives the "min" and "max" of the values and the number of
+	 * values in each bin ("bins").
+	 * \details The agent handlers of each master aggregate their agents in
+	 * parallel, then the aggregates of the masters are combined with MPI_Reduce.
+	 * A histogram needs a second pass, once the range of the values is known.
+	 * \note Aggregate is a control method.
+	 * \remark The returned value and the arguments are only significant for
+	 *         master 0.
+	 * \warning This function must only be externally called on master 0, while
+	 *          other masters are in WaitOrderFromRoot.
+	 */
+	ubjson::Value Aggregate(AgentType agent_type = 0, Attribute attr = 0,
+		Aggregation op = Aggregation::COUNT, size_t nb_bins = 0);
+
+	/**
+	 * \fn bool AddProbe(AgentType agent_type, Attribute attr, Aggregation op, Time period, std::string file)
+	 * \brief Adds a probe evaluating an aggregation of an attribute every
+	 *        period time steps, whose results are appended to a file.
+	 * \param agent_type Type identifier of the aggregated agents.
+	 * \param attr Attribute identifier of the aggregated attribute.
+	 * \param op Aggregation to compute, which cannot be a histogram.
+	 * \param period Number of time steps between two evaluations.
+	 * \param file Path of the time series, overwritten, or "-" to keep the
+	 *        records in memory until TakeProbesRecords.
+	 * \return Whether the probe was added.
+	 * \details The probe is evaluated at the end of each time step which is a
+	 * multiple of period, as in Aggregate. The reductions are nonblocking and
+	 * only completed at the next evaluation of the probes or at the end of the
+	 * run, so that they do not stall the time steps. The file begins with a
+	 * ProbeFileHeader describing the probe, followed by a sequence of records
+	 * made of the time step (uint64_t) and the value (double, NaN if
+	 * undefined), in the byte order of master 0. The records are buffered,
+	 * and flushed at the end of each run, by ClearProbes and when the master is
+	 * destroyed.
+	 * \note AddProbe is a control method.
+	 * \remark The returned value and the arguments are only significant for
+	 *         master 0.
+	 * \warning This function must only be externally called on master 0, while
+	 *          other masters are in WaitOrderFromRoot.
+	 */
+	bool AddProbe(AgentType agent_type = 0, Attribute attr = 0, Aggregation op = Aggregation::COUNT,
+		Time period = 1, std::string file = "");
+
+	/**
+	 * \fn void ClearProbes()
+	 * \brief Removes all the probes, after writing their pending results.
+	 * \note ClearProbes is a control method.
+	 * \warning This function must only be externally called on master 0, while
+	 *          other masters are in WaitOrderFromRoot.
+	 */
+	void ClearProbes();
+
+	/**
+	 * \fn ubjson::Value TakeProbesRecords()
+	 * \brief Returns and forgets the records of the probes kept in memory.
+	 * \return An array with, for each probe kept in memory, the names of its
+	 *         type, attribute and aggregation, its period, and its records as
+	 *         pairs [time step, value] (null if there is none).
+	 * \warning This function must only be called on master 0, between two
+	 *          control methods.
+	 */
+	ubjson::Value TakeProbesRecords();
+
+	/**
+	 * \fn void WaitExport()
+	 * \brief Waits until the last export started by ExportSimulationAsync is
+	 *        written.
+	 */
+	void WaitExport();
+
+	/**
+	 * \fn ubjson::Value GetStatistics(Time nb_steps)
+	 * \brief Gathers on master 0 the performance statistics of all masters over
+	 *        their last nb_steps time steps.
+	 * \param nb_steps Number of time steps to consider, at most
+	 *        STATISTICS_WINDOW (0 for all the recorded time steps).
+	 * \return A map with the number of time steps considered ("steps"), the
+	 * statistics of each master ("masters") and their aggregation ("total"):
+	 * average time per step of each phase, interactions and bytes exchanged,
+	 * MPI_Get and MPI_Put made, ratio of the public attribute reads served
+	 * without MPI_Get, and imbalance (slowest over average) of the agent
+	 * handlers. The total sums the counters and keeps the slowest master for
+	 * the times.
+	 * \note The argument nb_steps is only relevant for master 0.
+	 * \note GetStatistics is a control method.
+	 * \remark The returned value is only significant for master 0.
+	 * \warning This function must only be externally called on master 0, while
+	 *          other masters are in WaitOrderFromRoot.
+	 */
+	ubjson::Value GetStatistics(Time nb_steps = 0);
+
+	/**
+	 * \fn ubjson::Value GetPhaseTimings(Time nb_steps)
+	 * \brief Computes on master 0 the distribution of the time per step of
+	 *        each phase and of each synchronization, over the last time steps
+	 *        of all masters.
+	 * \param nb_steps Number of time steps to consider, at most
+	 *        STATISTICS_WINDOW (0 for all the recorded time steps).
+	 * \return A map with the number of time steps considered ("steps") and,
+	 * for each phase and each synchronization point ("timers"), the median
+	 * ("p50"), 95th percentile ("p95"), maximum ("max") and mean ("mean") of
+	 * its times on each master, each given by its minimum, average and maximum
+	 * over the masters ("min", "avg", "max").
+	 * \details Each master computes the percentiles of its recorded time
+	 * steps, which are combined by two MPI_Reduce, so that the cost of the
+	 * communications does not depend on nb_steps.
+	 * \note The argument nb_steps is only relevant for master 0.
+	 * \note GetPhaseTimings is a control method.
+	 * \remark The returned value is only significant for master 0.
+	 * \warning This function must only be externally called on master 0, while
+	 *          other masters are in WaitOrderFromRoot.
+	 */
+	ubjson::Value GetPhaseTimings(Time nb_steps = 0);
+
+	/**
+	 * \fn ubjson::Value GetTrafficMatrix(Time nb_steps)
+	 * \brief Gathers on master 0 the traffic between each pair of masters over
+	 *        their last nb_steps time steps.
+	 * \param nb_steps Number of time steps to consider, at most
+	 *        TRAFFIC_WINDOW (0 for all the recorded time steps).
+	 * \return A map with the number of time steps considered ("steps") and the
+	 * non-zero entries of the matrix ("traffic"), each with its source and
+	 * destination masters, its operation ("interaction", "get" or "put"), the
+	 * name of the interaction type ("type", interactions only), and the number
+	 * ("count") and bytes ("bytes") of the operations over the time steps.
+	 * \details The source of a get is the master which reads the window of the
+	 * destination. The reads of the windows of the masters of the same node are
+	 * made without MPI and not counted.
+	 * \note The argument nb_steps is only relevant for master 0.
+	 * \note GetTrafficMatrix is a control method.
+	 * \remark The returned value is only significant for master 0.
+	 * \warning This function must only be externally called on master 0, while
+	 *          other masters are in WaitOrderFromRoot.
+	 */
+	ubjson::Value GetTrafficMatrix(Time nb_steps = 0);
+
+	/**
+	 * \fn void SetAttributesProfiling(int enabled)
+	 * \brief Enables or disables the profiling of the reads of attributes on
+	 *        all masters.
+	 * \param enabled Whether the profiling must be enabled.
+	 * \details While enabled, each call of GetAttribute is counted by reader
+	 * type, target type and attribute, in the counters of AttributeAccess.
+	 * Enabling the profiling discards the previous counters.
+	 * \note The argument enabled is only relevant for master 0.
+	 * \note SetAttributesProfiling is a control method.
+	 * \warning This function must only be externally called on master 0, while
+	 *          other masters are in WaitOrderFromRoot.
+	 */
+	void SetAttributesProfiling(int enabled = 0);
+
+	/**
+	 * \fn ubjson::Value GetAttributesProfile()
+	 * \brief Sums on master 0 the attributes access profiles of all masters.
+	 * \return A map with the number of profiled time steps ("steps") and, for
+	 * each read attribute ("accesses"), the name of the type of the readers
+	 * ("reader", empty if unknown), of the type of the target agents
+	 * ("target"), of the attribute ("attribute") and the value of each counter
+	 * of AttributeAccess.
+	 * \details The distinct remote agents are counted per master and per time
+	 * step, then summed.
+	 * \note GetAttributesProfile is a control method.
+	 * \remark The returned value is only significant for master 0.
+	 * \warning This function must only be externally called on master 0, while
+	 *          other masters are in WaitOrderFromRoot.
+	 */
+	ubjson::Value GetAttributesProfile();
+
+	/**
+	 * \fn void SetTracing(int enabled)
+	 * \brief Enables or disables the tracing mode on all masters.
+	 * \param enabled Whether the tracing mode must be enabled.
+	 * \details In tracing mode, each thread of a master records the beginning
+	 * and end of the phases of the time steps, of the phases of the agent
+	 * handlers and of the collective communications, keeping its last
+	 * TRACE_BUFFER_SIZE events. Enabling the tracing mode discards the events
+	 * previously recorded and synchronizes the clocks of the masters.
+	 * \note The argument enabled is only relevant for master 0.
+	 * \note SetTracing is a control method.
+	 * \warning This function must only be externally called on master 0, while
+	 *          other masters are in WaitOrderFromRoot.
+	 */
+	void SetTracing(int enabled = 0);
+
+	/**
+	 * \fn bool DumpTrace(std::string file)
+	 * \brief Gathers on master 0 the trace events recorded by all masters and
+	 *        writes them to file in the Chrome trace event format.
+	 * \param file Path of the written file, readable by chrome://tracing and
+	 *        Perfetto.
+	 * \return Whether the file was written.
+	 * \details Each master is a process and each of its threads a thread of the
+	 * trace: thread 0 is the thread of the master and thread i+1 the agent
+	 * handler i.
+	 * \note The argument file is only relevant for master 0.
+	 * \note DumpTrace is a control method.
+	 * \remark The returned value is only significant for master 0.
+	 * \warning This function must only be externally called on master 0, while
+	 *          other masters are in WaitOrderFromRoot.
+	 */
+	bool DumpTrace(std::string file = "");
+
 	/**
 	 * \fn void KillSimulation()
 	 * \brief Orders the other masters that the simulation must be stopped and
@@ -361,6 +739,155 @@ private:
 	 */
 	MPI_Comm MasterComm_;
 
+	/**
+	 * Communicator for the masters sharing the memory of this master (usually
+	 * the masters on the same node).
+	 */
+	MPI_Comm NodeComm_;
+
+	/**
+	 * Identifiers of the masters of NodeComm_, by rank in NodeComm_.
+	 */
+	std::vector<MasterId> node_masters_;
+
+	/**
+	 * Identifiers of the masters holding the critical window of their node
+	 * (the masters of rank 0 in their NodeComm_).
+	 */
+	std::vector<MasterId> critical_holders_;
+
+	/**
+	 * Distributed graph communicator (on MasterComm_) linking this master to the
+	 * masters it exchanges interactions with, MPI_COMM_NULL while unknown.
+	 */
+	MPI_Comm NeighborsComm_;
+
+	/**
+	 * Identifiers of the neighbors of this master in NeighborsComm_, in
+	 * increasing order.
+	 */
+	std::vector<MasterId> neighbors_;
+
+	/**
+	 * For each master, whether it is in neighbors_.
+	 */
+	std::vector<bool> is_neighbor_;
+
+	/**
+	 * Masters to or from which this master sent or received interactions since
+	 * the last rebuild of NeighborsComm_.
+	 */
+	std::set<MasterId> observed_peers_;
+
+	/**
+	 * Queue of the one-sided operations submitted by the agent handlers to the
+	 * communication thread (the thread of the master) during RunBehaviors and
+	 * UpdateAllPublicAttributes.
+	 */
+	utils::mpsc_queue<RmaRequest> rma_requests_;
+
+	/**
+	 * Statistics of the last STATISTICS_WINDOW time steps, the statistics of
+	 * time step t being at index (t-1)%STATISTICS_WINDOW.
+	 */
+	std::vector<StepStatistics> statistics_;
+
+	/**
+	 * Statistics of the current time step.
+	 */
+	StepStatistics step_statistics_;
+
+	/**
+	 * Traffic sent by the master to each master during the last TRAFFIC_WINDOW
+	 * time steps, the traffic of time step t being at index
+	 * (t-1)%TRAFFIC_WINDOW. The traffic with master m begins at TrafficOffset(m)
+	 * and holds the number of interactions of each type, their bytes, then the
+	 * number of MPI_Get, their bytes, the number of MPI_Put and their bytes.
+	 */
+	std::vector<std::vector<double>> traffic_;
+
+	/**
+	 * Traffic of the current time step, in the layout of traffic_.
+	 */
+	std::vector<double> step_traffic_;
+
+	/**
+	 * Whether the reads of attributes are profiled.
+	 */
+	bool attributes_profiling_;
+
+	/**
+	 * Number of time steps run since the profiling of the reads of attributes
+	 * was enabled.
+	 */
+	Time attributes_profile_steps_;
+
+	/**
+	 * Largest attribute identifier plus one, over all agent types.
+	 */
+	Attribute max_nb_attributes_;
+
+	/**
+	 * Counters of the reads of attributes since the profiling was enabled, the
+	 * counters of each (reader type, target type, attribute) beginning at
+	 * AttributeAccessOffset and following the order of AttributeAccess.
+	 */
+	std::vector<std::atomic<uint64_t>> attributes_accesses_;
+
+	/**
+	 * Remote agents read during the current time step, with the offset of the
+	 * counters of the read, to count the distinct remote agents.
+	 */
+	utils::thread_safe_unordered_map<std::pair<AgentGlobalId, size_t>, bool,
+		hash_pair<AgentGlobalId, size_t>> profiled_remote_agents_;
+
+	/**
+	 * Whether the tracing mode is enabled.
+	 */
+	bool tracing_;
+
+	/**
+	 * Time at which the tracing mode was enabled, synchronized between the
+	 * masters, used as origin of the trace.
+	 */
+	std::chrono::steady_clock::time_point trace_start_;
+
+	/**
+	 * Last events recorded by each thread in tracing mode: the thread of the
+	 * master at index 0, agent handler i at index i+1.
+	 */
+	std::vector<utils::ring_buffer<TraceEvent>> trace_buffers_;
+
+	/**
+	 * Thread of master 0 writing the last export started by
+	 * ExportSimulationAsync.
+	 */
+	std::thread export_thread_;
+
+	/**
+	 * Probes evaluated by the masters, and their time series (only opened on
+	 * master 0), or their records if they are kept in memory.
+	 */
+	std::vector<ProbeDescription> probes_;
+	std::vector<std::ofstream> probes_files_;
+	std::vector<std::vector<std::pair<Time, double>>> probes_records_;
+
+	/**
+	 * Probes whose reductions are pending, and time step of their evaluation.
+	 */
+	std::vector<size_t> pending_probes_;
+	Time pending_probes_step_;
+
+	/**
+	 * Buffers of the pending reductions of the probes: (count, sum) reduced
+	 * with MPI_SUM and (min, -max) with MPI_MIN for each pending probe.
+	 */
+	std::vector<double> probes_sums_;
+	std::vector<double> probes_bounds_;
+	std::vector<double> probes_global_sums_;
+	std::vector<double> probes_global_bounds_;
+	MPI_Request probes_requests_[2];
+
 	/**
 	 * Total number of masters.
 	 */
@@ -377,6 +904,12 @@ private:
 	 */
 	std::vector<AgentId> maximal_ids_;
 
+	/**
+	 * Number of fresh identifiers given by this master for each type since the
+	 * last update of maximal_ids_.
+	 */
+	std::vector<std::atomic<AgentId>> fresh_ids_;
+
 	/**
 	 * Number of interaction types.
 	 */
@@ -407,6 +940,24 @@ private:
 	 */
 	MPI_Win critical_window_;
 
+	/**
+	 * Shared memory window of NodeComm_ in which public_window_ is stored, so
+	 * that the masters of the same node can read it directly.
+	 */
+	MPI_Win node_public_window_;
+
+	/**
+	 * Shared memory window of NodeComm_ in which critical_window_ is stored
+	 * once for the whole node (by the master of rank 0 in NodeComm_).
+	 */
+	MPI_Win node_critical_window_;
+
+	/**
+	 * Beginning of the public window of each master sharing the memory of this
+	 * master, nullptr for the other masters.
+	 */
+	std::vector<char*> colocated_public_windows_;
+
 	/**
 	 * Pointer pointing towards the beginning of the content of public_window.
 	 */
@@ -480,6 +1031,36 @@ private:
 	 */
 	std::vector<AgentHandler> agent_handlers_;
 
+	/**
+	 * Whether the number of agent handlers is chosen automatically by
+	 * AdaptNbAgentHandlers.
+	 */
+	bool auto_agent_handlers_;
+
+	/**
+	 * Map associating to a number of agent handlers the average duration (in
+	 * seconds) of the phases they run during a time step, as measured in
+	 * automatic mode.
+	 */
+	std::map<size_t, double> agent_handlers_times_;
+
+	/**
+	 * Time spent in the phases run by the agent handlers since the last call
+	 * to AdaptNbAgentHandlers.
+	 */
+	double agent_handlers_time_;
+
+	/**
+	 * Number of time steps measured in agent_handlers_time_.
+	 */
+	Time agent_handlers_measured_steps_;
+
+	/**
+	 * Number of calls to AdaptNbAgentHandlers, used to periodically forget the
+	 * measured durations.
+	 */
+	size_t auto_agent_handlers_rounds_;
+
 	/**
 	 * Map of the sizes of all (public and private) sendable attributes for all
 	 * types of agents.
@@ -505,6 +1086,18 @@ private:
 	 */
 	std::unordered_map<AgentGlobalId, size_t> public_agents_offsets_;
 
+	/**
+	 * Offsets of the freed structures of public attributes in the public window
+	 * of each master, by agent type, to be reused by the next agents of the
+	 * same type arriving on this master (the same on all masters).
+	 */
+	std::vector<std::unordered_map<AgentType, std::vector<size_t>>> free_public_slots_;
+
+	/**
+	 * Number of agents held by each master.
+	 */
+	std::vector<size_t> nb_agents_by_master_;
+
 	/**
 	 * Map of the sizes of the whole structure of public (non critical)
 	 * attributes for all types of agents.
@@ -523,6 +1116,12 @@ private:
 	 */
 	std::unordered_map<AgentGlobalId, size_t> critical_agents_offsets_;
 
+	/**
+	 * Offsets of the freed structures of critical attributes in the critical
+	 * window, by agent type (the same on all masters).
+	 */
+	std::unordered_map<AgentType, std::vector<size_t>> free_critical_slots_;
+
 	/**
 	 * Map of the sizes of the whole structire of critical attributes of an
 	 * agent, for all types of agents.
@@ -535,6 +1134,11 @@ private:
 	 */
 	std::unordered_map<AgentType, AgentName> agent_type_to_string_;
 
+	/**
+	 * Name of each interaction type.
+	 */
+	std::vector<InteractionName> interaction_type_to_string_;
+
 	/**
 	 * Associates to each attribute its name.
 	 * \attention This structure is empty in all masters but master 0.
@@ -578,10 +1182,34 @@ private:
 
 	/**
 	 * Memory location where the received public non critical attributes are
-	 * stored.
+	 * stored (only allocated by the communication thread).
 	 */
 	utils::custom_heap stored_public_attributes_;
 
+	/**
+	 * Agents held by other masters whose public attributes were read by an
+	 * agent of this master since the last choice of the replicated agents.
+	 */
+	utils::thread_safe_unordered_map<AgentGlobalId, bool> remotely_read_agents_;
+
+	/**
+	 * Agents whose public attributes are sent to all masters at each time step,
+	 * in increasing order (the same on all masters).
+	 */
+	std::vector<AgentGlobalId> replicated_agents_;
+
+	/**
+	 * Copies of the structures of public attributes of the replicated agents
+	 * for the current time step.
+	 */
+	std::vector<char> replicas_;
+
+	/**
+	 * Offsets of the structures of public attributes of the replicated agents
+	 * in replicas_.
+	 */
+	std::unordered_map<AgentGlobalId, size_t> replicas_offsets_;
+
 	/**
 	 * \fn AgentGlobalId LocalToGlobalId(AgentId id, AgentType type)
 	 * \brief Computes the global id of an agent from its local identifiers.
@@ -667,18 +1295,58 @@ private:
 	bool HasReceivedAttribute(Attribute attr, AgentGlobalId id, void* &location);
 
 	/**
-	 * \fn void InitializeAgents(std::vector<void*> &initial_agents)
+	 * \fn void InitializeAgents(std::vector<void*> &initial_agents, const PlacementDescription &placement)
 	 * \brief Initialize all parameters about the initial agents in all masters.
 	 * \param initial_agents Reference to the vector containing the pointers to
 	 *        AgentStructs representing the initial agents of the simulation.
+	 * \param placement Description of the interaction graph of the initial
+	 *        agents.
 	 * \details Receives all the initial agents from master 0 (initially stored
 	 * in initial_agents) and adds them in this master. Receives also the
 	 * masters attribution of all agents. Finally, use the available data about
 	 * the agents to initialize the windows.
-	 * \attention initial_agents is only useful for master 0; all other should
-	 *            receive an empty vector.
+	 * \attention initial_agents and placement are only useful for master 0; all
+	 *            other should receive empty ones.
 	 */
-	void InitializeAgents(std::vector<void*> &initial_agents);
+	void InitializeAgents(std::vector<void*> &initial_agents, const PlacementDescription &placement);
+
+	/**
+	 * \fn void BuildInteractionGraph(std::vector<void*> &initial_agents, const PlacementDescription &placement,
+	 *                                std::vector<AgentEdge> &edges, std::vector<uint64_t> &weights)
+	 * \brief Computes the interaction graph of the initial agents given to
+	 *        AssignInitialMasters.
+	 * \param initial_agents Reference to the vector containing the pointers to
+	 *        AgentStructs representing the initial agents of the simulation.
+	 * \param placement Description of the interaction graph of the initial
+	 *        agents.
+	 * \param edges Reference to the vector which will contain the explicit
+	 *        edges of placement and the edges derived from its attribute
+	 *        links.
+	 * \param weights Reference to the vector which will contain the weight of
+	 *        each initial agent.
+	 * \details Attribute links are resolved by reading the attribute in the
+	 * agent built from its structure; links whose target does not exist are
+	 * ignored.
+	 */
+	void BuildInteractionGraph(std::vector<void*> &initial_agents, const PlacementDescription &placement,
+		std::vector<AgentEdge> &edges, std::vector<uint64_t> &weights);
+
+	/**
+	 * \fn void BuildCoordinates(std::vector<void*> &initial_agents, const PlacementDescription &placement,
+	 *                           std::vector<std::vector<double>> &coordinates)
+	 * \brief Reads the coordinates of the initial agents given to
+	 *        AssignInitialMasters.
+	 * \param initial_agents Reference to the vector containing the pointers to
+	 *        AgentStructs representing the initial agents of the simulation.
+	 * \param placement Description of the coordinate attributes of each type.
+	 * \param coordinates Reference to the vector which will contain the
+	 *        coordinates of each initial agent (empty if its type has none).
+	 * \details The attributes are read in the agent built from its structure;
+	 * they must be of a numerical MPI type, otherwise the agent is considered
+	 * without coordinates.
+	 */
+	void BuildCoordinates(std::vector<void*> &initial_agents, const PlacementDescription &placement,
+		std::vector<std::vector<double>> &coordinates);
 
 	/**
 	 * \fn void InitializeWindows(std::vector<AgentGlobalId> &agent_ids)
@@ -703,6 +1371,54 @@ private:
 	 */
 	void FillWindows(std::vector<AgentGlobalId> &agent_ids);
 
+	/**
+	 * \fn void* CreatePublicWindow(size_t size, MPI_Win &node_window, MPI_Win &window)
+	 * \brief Allocates the public window of this master in the shared memory of
+	 *        its node.
+	 * \param size Size of the public window in bytes.
+	 * \param node_window Reference to the shared memory window created on
+	 *        NodeComm_.
+	 * \param window Reference to the window created on MasterComm_ over the
+	 *        same memory, used by the masters of the other nodes.
+	 * \return The beginning of the public window of this master.
+	 * \details Also updates colocated_public_windows_.
+	 * \warning Collective operation on all masters.
+	 */
+	void* CreatePublicWindow(size_t size, MPI_Win &node_window, MPI_Win &window);
+
+	/**
+	 * \fn void* CreateCriticalWindow(size_t size, MPI_Win &node_window, MPI_Win &window)
+	 * \brief Allocates the critical window once per node, in the shared memory
+	 *        of the master of rank 0 in NodeComm_.
+	 * \param size Size of the critical window in bytes.
+	 * \param node_window Reference to the shared memory window created on
+	 *        NodeComm_.
+	 * \param window Reference to the window created on MasterComm_ over the
+	 *        same memory (empty on the masters not in critical_holders_).
+	 * \return The beginning of the critical window of the node.
+	 * \warning Collective operation on all masters.
+	 */
+	void* CreateCriticalWindow(size_t size, MPI_Win &node_window, MPI_Win &window);
+
+	/**
+	 * \fn void FreeWindow(MPI_Win &node_window, MPI_Win &window)
+	 * \brief Frees a window created by CreatePublicWindow or
+	 *        CreateCriticalWindow.
+	 * \param node_window Reference to the shared memory window.
+	 * \param window Reference to the window created on MasterComm_.
+	 * \warning Collective operation on all masters.
+	 */
+	void FreeWindow(MPI_Win &node_window, MPI_Win &window);
+
+	/**
+	 * \fn void SynchronizeNodeWindows()
+	 * \brief Makes the writes in the shared memory windows visible to the
+	 *        other masters of the node (and theirs visible to this master).
+	 * \details Must be called by the writers before, and by the readers after,
+	 * the synchronization separating a writing phase from a reading phase.
+	 */
+	void SynchronizeNodeWindows();
+
 	/**
 	 * \fn void AddAgent(AgentHandler &agent_handler, void *structure)
 	 * \brief Creates an agent of the right type from the structure representing
@@ -714,12 +1430,277 @@ private:
 	 */
 	void AddAgent(AgentHandler &agent_handler, void *structure);
 
+	/**
+	 * \fn void RemoveAgent(AgentGlobalId id)
+	 * \brief Deletes an agent held by this master from its agent handler and
+	 *        from this master.
+	 * \param id Global identifier of the agent.
+	 */
+	void RemoveAgent(AgentGlobalId id);
+
+	/**
+	 * \fn void CountTraffic(Agent* agent, MasterId master)
+	 * \brief Counts a communication between an agent of this master and an
+	 *        agent held by master.
+	 * \param agent Pointer to the agent of this master.
+	 * \param master Identifier of the master of the other agent.
+	 */
+	void CountTraffic(Agent* agent, MasterId master);
+
+	/**
+	 * \fn size_t AllocatePublicSlot(MasterId master, AgentType type)
+	 * \brief Reserves the space for the public attributes of an agent of type
+	 *        type in the public window of master.
+	 * \param master Identifier of the master holding the agent.
+	 * \param type Type identifier of the agent.
+	 * \return The offset of the reserved space in the public window.
+	 * \details Reuses a freed slot of the same type if there is one, and takes
+	 * space at the end of the used part of the window otherwise, which may then
+	 * exceed the size of the window (see ResizePublicWindows).
+	 * \warning Must be called in the same order on all masters.
+	 */
+	size_t AllocatePublicSlot(MasterId master, AgentType type);
+
+	/**
+	 * \fn void FreePublicSlot(MasterId master, AgentType type, size_t offset)
+	 * \brief Releases the space of the public attributes of an agent of type
+	 *        type in the public window of master.
+	 * \param master Identifier of the master which held the agent.
+	 * \param type Type identifier of the agent.
+	 * \param offset Offset of the released space in the public window.
+	 * \warning Must be called in the same order on all masters.
+	 */
+	void FreePublicSlot(MasterId master, AgentType type, size_t offset);
+
+	/**
+	 * \fn void ResizePublicWindows(size_t new_size)
+	 * \brief Replaces the public windows of all masters by windows of size
+	 *        new_size, keeping their content.
+	 * \param new_size New size of the public windows in bytes.
+	 * \warning Collective operation on all masters.
+	 */
+	void ResizePublicWindows(size_t new_size);
+
+	/**
+	 * \fn size_t AllocateCriticalSlot(AgentType type)
+	 * \brief Reserves the space for the critical attributes of an agent of type
+	 *        type in the critical window.
+	 * \param type Type identifier of the agent.
+	 * \return The offset of the reserved space in the critical window.
+	 * \see AllocatePublicSlot
+	 * \warning Must be called in the same order on all masters.
+	 */
+	size_t AllocateCriticalSlot(AgentType type);
+
+	/**
+	 * \fn void FreeCriticalSlot(AgentType type, size_t offset)
+	 * \brief Releases the space of the critical attributes of an agent of type
+	 *        type in the critical window.
+	 * \param type Type identifier of the agent.
+	 * \param offset Offset of the released space in the critical window.
+	 * \warning Must be called in the same order on all masters.
+	 */
+	void FreeCriticalSlot(AgentType type, size_t offset);
+
+	/**
+	 * \fn void ResizeCriticalWindow(size_t new_size)
+	 * \brief Replaces the critical window of all masters by a window of size
+	 *        new_size, keeping its content.
+	 * \param new_size New size of the critical window in bytes.
+	 * \warning Collective operation on all masters.
+	 */
+	void ResizeCriticalWindow(size_t new_size);
+
+	/**
+	 * \fn void GrowWindows()
+	 * \brief Resizes the public and critical windows if the space used in
+	 *        one of them exceeds its size.
+	 * \warning Collective operation on all masters.
+	 */
+	void GrowWindows();
+
+	/**
+	 * \fn void ApplyMetaEvolutions()
+	 * \brief Performs the deaths, migrations and births of
+	 *        GlobalMetaEvolutionDescriptions.
+	 * \details Updates the directory of the agents, their identifiers and
+	 * their windows offsets on all masters in the same order. Then removes the
+	 * dead agents, sends the migrating agents to their new masters (which put
+	 * them on their least loaded agent handler), and adds the new agents to the
+	 * agent handlers of their parents.
+	 * \warning Collective operation on all masters.
+	 */
+	void ApplyMetaEvolutions();
+
+	/**
+	 * \fn void RecycleFreshIds(std::vector<AgentId> &previous_maximal_ids)
+	 * \brief Gives to the agent handlers the fresh identifiers of this master
+	 *        which were skipped when maximal_ids_ grew, and resets fresh_ids_.
+	 * \param previous_maximal_ids Reference to the values of maximal_ids_
+	 *        before the births of the current time step.
+	 */
+	void RecycleFreshIds(std::vector<AgentId> &previous_maximal_ids);
+
+	/**
+	 * \fn void BalanceAgentHandlers()
+	 * \brief Moves agents between the agent handlers of this master according
+	 *        to their measured behavior costs.
+	 * \details Only changes which agent handler owns an agent, so that the
+	 * agents are neither copied nor sent to another master.
+	 * \see RebalanceAgentHandlers
+	 */
+	void BalanceAgentHandlers();
+
+	/**
+	 * \fn void ResizeAgentHandlers(size_t nb_agent_handlers)
+	 * \brief Creates or removes agent handlers so that this master has
+	 *        nb_agent_handlers of them, and balances the agents between them.
+	 * \param nb_agent_handlers The new number of agent handlers (at least 1).
+	 * \details The agents of the removed agent handlers, as well as their
+	 * staged births, deaths and free identifiers, are given to the remaining
+	 * ones. Windows are left untouched since agents do not change of master.
+	 * \warning Must be called between time steps.
+	 */
+	void ResizeAgentHandlers(size_t nb_agent_handlers);
+
+	/**
+	 * \fn void AdaptNbAgentHandlers()
+	 * \brief Records the average duration of the phases run by the agent
+	 *        handlers during the last AUTO_HANDLERS_PERIOD time steps, and
+	 *        resizes the agent handlers as chosen by ChooseNbAgentHandlers.
+	 * \details The number of agent handlers is at most the number of cores of
+	 * the node divided by the number of its masters, minus one for the thread
+	 * of the master which serves the communications.
+	 */
+	void AdaptNbAgentHandlers();
+
+	/**
+	 * \fn void RedirectInteractions()
+	 * \brief Moves the interactions waiting in interactions_to_send_ whose
+	 *        recipient changed of master to the queue of its new master, and
+	 *        discards those whose recipient died.
+	 */
+	void RedirectInteractions();
+
 	/**
 	 * \fn void Synchronize()
 	 * \brief Synchronizes all the masters and the agent handlers.
 	 */
 	void Synchronize();
 
+	/**
+	 * \fn std::chrono::steady_clock::time_point TimePhase(Phase phase, std::chrono::steady_clock::time_point start)
+	 * \brief Adds the time elapsed since start to the time of phase in the
+	 *        statistics of the current time step.
+	 * \param phase The phase which just ended.
+	 * \param start The time at which phase started.
+	 * \return The current time, at which the next phase starts.
+	 */
+	std::chrono::steady_clock::time_point TimePhase(Phase phase, std::chrono::steady_clock::time_point start);
+
+	/**
+	 * \fn std::chrono::steady_clock::time_point TimeSynchronization(SyncPoint point, std::chrono::steady_clock::time_point start)
+	 * \brief Adds the time elapsed since start to the time of point and to the
+	 *        time of the phase SYNCHRONIZATION in the statistics of the current
+	 *        time step.
+	 * \param point The call of Synchronize which just ended.
+	 * \param start The time at which the call started.
+	 * \return The current time, at which the next phase starts.
+	 */
+	std::chrono::steady_clock::time_point TimeSynchronization(SyncPoint point, std::chrono::steady_clock::time_point start);
+
+	/**
+	 * \fn size_t TrafficOffset(MasterId peer)
+	 * \brief Returns the index of the traffic with peer in a time step of
+	 *        traffic_.
+	 */
+	size_t TrafficOffset(MasterId peer) const {
+		return peer*(2*nb_interactions_ + 4);
+	}
+
+	/**
+	 * \fn size_t AttributeAccessOffset(AgentType reader, AgentType target, Attribute attr)
+	 * \brief Returns the index of the counters of attributes_accesses_ of the
+	 *        reads of attr of the agents of type target by the agents of type
+	 *        reader (nb_types_ if unknown).
+	 */
+	size_t AttributeAccessOffset(AgentType reader, AgentType target, Attribute attr) const {
+		return ((reader*nb_types_ + target)*max_nb_attributes_ + attr)*NB_ATTRIBUTE_ACCESSES;
+	}
+
+	/**
+	 * \fn void CountAttributeAccess(Agent* reader, AgentGlobalId recipient, Attribute attr, AttributeAccess access)
+	 * \brief Counts a read of attr of recipient by reader in the attributes
+	 *        access profile, and the first read of a remote recipient in the
+	 *        time step.
+	 * \details Thread-safe.
+	 */
+	void CountAttributeAccess(Agent* reader, AgentGlobalId recipient, Attribute attr, AttributeAccess access);
+
+	/**
+	 * \fn ubjson::Value StatisticsToJson(const StepStatistics &statistics, Time nb_steps)
+	 * \brief Converts statistics accumulated over nb_steps time steps to the
+	 *        per step values returned by GetStatistics.
+	 * \param statistics Reference to the accumulated statistics.
+	 * \param nb_steps Number of time steps accumulated in statistics.
+	 * \return The json representation of the statistics.
+	 */
+	ubjson::Value StatisticsToJson(const StepStatistics &statistics, Time nb_steps);
+
+	/**
+	 * \fn std::unordered_map<AgentType, size_t> AgentStructsSizes()
+	 * \brief Computes the number of bytes to copy to duplicate the structure
+	 *        of an agent of each type.
+	 * \return A map associating its size to each agent type.
+	 */
+	std::unordered_map<AgentType, size_t> AgentStructsSizes();
+
+	/**
+	 * \fn AttributeAggregate AggregateLocally(AgentType agent_type, Attribute attr, AttributeReader read, const AttributeAggregate &initial)
+	 * \brief Aggregates an attribute over the agents of a type held by this
+	 *        master, with one thread per agent handler.
+	 * \param agent_type Type identifier of the aggregated agents.
+	 * \param attr Attribute identifier of the aggregated attribute.
+	 * \param read Function reading the attribute as a double.
+	 * \param initial Empty aggregate, whose histogram bins are filled if any.
+	 * \return The aggregate of the agents of this master.
+	 */
+	AttributeAggregate AggregateLocally(AgentType agent_type, Attribute attr, AttributeReader read,
+		const AttributeAggregate &initial);
+
+	/**
+	 * \fn void EvaluateProbes()
+	 * \brief Starts the reductions of the probes whose period divides the
+	 *        current time step, after completing the previous ones.
+	 */
+	void EvaluateProbes();
+
+	/**
+	 * \fn void CompleteProbes()
+	 * \brief Waits for the pending reductions of the probes, and appends their
+	 *        results to the files of the probes on master 0.
+	 */
+	void CompleteProbes();
+
+	/**
+	 * \fn void FlushProbes()
+	 * \brief Writes the buffered records of the files of the probes, once per
+	 *        run and not per record.
+	 */
+	void FlushProbes();
+
+	/**
+	 * \fn std::chrono::steady_clock::time_point Trace(size_t thread, const char* name, std::chrono::steady_clock::time_point begin)
+	 * \brief Records, in tracing mode, an event of thread which started at
+	 *        begin and ends now.
+	 * \param thread Index of the trace buffer of the calling thread (0 for
+	 *        the thread of the master, i+1 for agent handler i).
+	 * \param name Name of the event, which must be a string literal.
+	 * \param begin The time at which the event started.
+	 * \return The current time, at which the next event starts.
+	 */
+	std::chrono::steady_clock::time_point Trace(size_t thread, const char* name, std::chrono::steady_clock::time_point begin);
+
 	/**
 	 * \fn void DistributeReceivedInteractions()
 	 * \brief Distributes to the agents the interactions received in a time
@@ -736,19 +1717,37 @@ private:
 	void RunBehaviors();
 
 	/**
-	 * \fn void* GetPublicAttribute(Attribute attr, AgentGlobalId recipient)
+	 * \fn void RunAgentHandlers(void (AgentHandler::*phase)(), const char* name, MPI_Win window)
+	 * \brief Executes phase on all agent handlers in parallel, while the thread
+	 *        of the master serves their one-sided operations on window.
+	 * \param phase Method of AgentHandler to execute.
+	 * \param name Name of phase in the trace.
+	 * \param window Window on which the operations of rma_requests_ are made.
+	 * \details The thread of the master is the communication thread: it issues
+	 * the operations submitted in rma_requests_, completes the gets with
+	 * MPI_Win_flush_local_all before releasing their waiting agent handlers,
+	 * and polls MPI in between so that the one-sided operations of the other
+	 * masters progress.
+	 * \pre An access epoch must be open on window.
+	 */
+	void RunAgentHandlers(void (AgentHandler::*phase)(), const char* name, MPI_Win window);
+
+	/**
+	 * \fn void* GetPublicAttribute(Attribute attr, AgentGlobalId recipient, Agent* reader)
 	 * \brief Processes a public non critical attribute request from an agent
 	 *        managed by this master.
 	 * \param attr Attribute identifier of the requested attribute.
 	 * \param recipient Global identifier of the agent whose attribute attr is
 	 *        requested.
+	 * \param reader Pointer to the agent asking for the attribute (may be
+	 *        nullptr).
 	 * \return A pointer to the memory location where the value of the requested
 	 *         attribute is stored.
 	 * \details The attribute attr is asked to the agent recipient, and is
 	 * copied in the memory location which the returned pointer points to.
 	 * \warning The value pointed by the returned pointer must not be modified.
 	 */
-	void* GetPublicAttribute(Attribute attr, AgentGlobalId recipient);
+	void* GetPublicAttribute(Attribute attr, AgentGlobalId recipient, Agent* reader);
 
 	/**
 	 * \fn void* GetCriticalAttribute(Attribute attr, AgentGlobalId recipient)
@@ -768,18 +1767,86 @@ private:
 	 */
 	void UpdateAllPublicAttributes();
 
+	/**
+	 * \fn void ReplicatePublicAttributes()
+	 * \brief Sends the public attributes of the replicated agents to all
+	 *        masters, so that reading them does not need any MPI_Get.
+	 * \details Every REPLICATION_PERIOD time steps, each master first sends
+	 * the agents it read remotely to their masters with MPI_Alltoallv; each
+	 * master chooses which of its agents are replicated with
+	 * heuristics:ChooseReplicatedAgents, and only the chosen agents are
+	 * gathered on all masters. Nothing is exchanged while no agent is
+	 * replicated.
+	 * \warning Collective operation on all masters, to call after
+	 * UpdateAllPublicAttributes.
+	 */
+	void ReplicatePublicAttributes();
+
 	/**
 	 * \fn void SendReceiveInteractions()
 	 * \brief Sends all interactions emitted by the agents to the masters of
 	 * their recipients and receives all interactions to be read by this
 	 * master's agents.
+	 * \details The numbers of interactions are exchanged with the neighbors
+	 * of NeighborsComm_ when all masters only send interactions to their
+	 * neighbors, with ExchangeCountsSparse otherwise, after which the graph is
+	 * extended with the new peers. The graph is rebuilt from the peers observed
+	 * every NEIGHBORS_PERIOD time steps.
+	 * \warning Collective operation on all masters.
 	 */
 	void SendReceiveInteractions();
 
+	/**
+	 * \fn void ExchangeCountsWithNeighbors(std::vector<int> &nb_messages_to_send,
+	 *                                      std::vector<int> &nb_messages_to_receive)
+	 * \brief Exchanges the numbers of interactions of each type with the
+	 *        neighbors of NeighborsComm_ using MPI_Neighbor_alltoall.
+	 * \param nb_messages_to_send Reference to the numbers of interactions to
+	 *        send, by master and interaction type.
+	 * \param nb_messages_to_receive Reference to the vector filled with the
+	 *        numbers of interactions to receive, by master and interaction type.
+	 * \pre No interaction must be sent to a master out of neighbors_.
+	 */
+	void ExchangeCountsWithNeighbors(std::vector<int> &nb_messages_to_send,
+		std::vector<int> &nb_messages_to_receive);
+
+	/**
+	 * \fn void ExchangeCountsSparse(std::vector<int> &nb_messages_to_send,
+	 *                               std::vector<int> &nb_messages_to_receive)
+	 * \brief Exchanges the numbers of interactions of each type with the masters
+	 *        actually communicating with this one, without knowing them.
+	 * \param nb_messages_to_send Reference to the numbers of interactions to
+	 *        send, by master and interaction type.
+	 * \param nb_messages_to_receive Reference to the vector filled with the
+	 *        numbers of interactions to receive, by master and interaction type.
+	 * \details Non-blocking consensus (NBX): the counts are sent with
+	 * synchronous sends and received as they are probed, until a non-blocking
+	 * barrier started once all local sends were matched completes.
+	 */
+	void ExchangeCountsSparse(std::vector<int> &nb_messages_to_send,
+		std::vector<int> &nb_messages_to_receive);
+
+	/**
+	 * \fn void BuildNeighborsGraph(std::set<MasterId> &neighbors)
+	 * \brief Replaces NeighborsComm_ by a distributed graph communicator
+	 *        linking this master to neighbors.
+	 * \param neighbors Reference to the set of the new neighbors.
+	 * \pre The relation must be symmetric (m is a neighbor of this master if
+	 * and only if this master is a neighbor of m).
+	 * \warning Collective operation on all masters.
+	 */
+	void BuildNeighborsGraph(std::set<MasterId> &neighbors);
+
 	/**
 	 * \fn void MetaEvolution()
 	 * \brief Decides the agents that should migrate, and performs agent deaths,
 	 *        births and migrations.
+	 * \details Deaths and births are staged by the agent handlers during the
+	 * previous time step. The masters first exchange the number of their meta
+	 * evolutions, so that a time step without any costs a single MPI_Allgather;
+	 * otherwise the descriptions are exchanged and applied by
+	 * ApplyMetaEvolutions. Migrations are only decided every MIGRATION_PERIOD
+	 * time steps.
 	 */
 	void MetaEvolution();
 
@@ -789,16 +1856,6 @@ private:
 	 */
 	void RunTimeStep();
 
-	/**
-	 * Contains the agents that we need to create at each time step.
-	 */
-	utils::thread_safe_vector<std::pair<AgentType, void *>> AgentsToCreate;
-
-	/**
-	 * Contains the agents that we need to delete at each time step.
-	 */
-	utils::thread_safe_vector<AgentId> AgentsToDelete;
-
 	/**
 	 * Contains the MetaEvolutions that we will send to other Masters.
 	 */
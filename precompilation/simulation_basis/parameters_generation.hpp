@@ -158,6 +158,16 @@ void CreateAgentsNamesRelation(
 void CreateAttributesNamesRelation(
 	AttributesNames &attribute_to_string, AttributesIds &string_to_attribute);
 
+/**
+ * \fn void CreateInteractionsNames(std::vector<InteractionName> &interaction_type_to_string)
+ * \brief Fills the interaction_type_to_string_ of a master.
+ * \param interaction_type_to_string Reference to a interaction_type_to_string_
+ *        of a master, indexed by the interaction types.
+ * \remark Generated in the precompilation step.
+ * \see Master
+ */
+void CreateInteractionsNames(std::vector<InteractionName> &interaction_type_to_string);
+
 /**
  * \fn AgentType NbAgentTypes()
  * \brief Returns the number of agent types in the model.
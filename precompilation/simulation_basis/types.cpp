@@ -1,4 +1,10 @@
 #include <mpi.h>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <string>
+#include <limits>
+#include <type_traits>
 
 #include "types.hpp"
 
@@ -13,8 +19,101 @@ void generateMPIDatatype(MPI_Datatype &type) {
 		offsetof(MetaEvolutionDescription, destination_id),
 		offsetof(MetaEvolutionDescription, private_overhead)
 	};
-	MPI_Datatype MetaEvolutionDescriptionFields[5] = {MPI_INT, MPI_UINT64_T, MPI_INT, MPI_INT, MPI_INT};
+	MPI_Datatype MetaEvolutionDescriptionFields[5] = {MPI_INT, MPI_UINT64_T, MPI_INT, MPI_INT, MPI_UINT64_T};
 
 	MPI_Type_create_struct(5, MetaEvolutionDescriptionBlockLength, MetaEvolutionDescriptionOffsets, MetaEvolutionDescriptionFields, &type);
 	MPI_Type_commit(&type);
 }
+
+
+void IdleBcast(void* buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm) {
+	MPI_Request request;
+	MPI_Ibcast(buffer, count, datatype, root, comm, &request);
+	int done = 0;
+	int tests = 0;
+	int sleep = IDLE_MIN_SLEEP;
+	MPI_Test(&request, &done, MPI_STATUS_IGNORE);
+	while (!done) {
+		if (++tests > IDLE_SPIN_TESTS) {
+			std::this_thread::sleep_for(std::chrono::microseconds(sleep));
+			sleep = std::min(2*sleep, IDLE_MAX_SLEEP);
+		}
+		MPI_Test(&request, &done, MPI_STATUS_IGNORE);
+	}
+}
+
+
+template <typename T>
+static double ReadAttribute(const void* location) {
+	return static_cast<double>(*static_cast<const T*>(location));
+}
+
+
+AttributeReader GetAttributeReader(MPI_Datatype datatype) {
+	if (datatype == MPI_DOUBLE) return ReadAttribute<double>;
+	if (datatype == MPI_FLOAT) return ReadAttribute<float>;
+	if (datatype == MPI_LONG_DOUBLE) return ReadAttribute<long double>;
+	if (datatype == MPI_CHAR || datatype == MPI_SIGNED_CHAR || datatype == MPI_INT8_T) return ReadAttribute<int8_t>;
+	if (datatype == MPI_SHORT || datatype == MPI_INT16_T) return ReadAttribute<int16_t>;
+	if (datatype == MPI_INT || datatype == MPI_INT32_T) return ReadAttribute<int32_t>;
+	if (datatype == MPI_LONG || datatype == MPI_LONG_LONG || datatype == MPI_LONG_LONG_INT || datatype == MPI_INT64_T) return ReadAttribute<int64_t>;
+	if (datatype == MPI_UNSIGNED_CHAR || datatype == MPI_UINT8_T) return ReadAttribute<uint8_t>;
+	if (datatype == MPI_CXX_BOOL || datatype == MPI_C_BOOL) return ReadAttribute<bool>;
+	if (datatype == MPI_UNSIGNED_SHORT || datatype == MPI_UINT16_T) return ReadAttribute<uint16_t>;
+	if (datatype == MPI_UNSIGNED || datatype == MPI_UINT32_T) return ReadAttribute<uint32_t>;
+	if (datatype == MPI_UNSIGNED_LONG || datatype == MPI_UNSIGNED_LONG_LONG || datatype == MPI_UINT64_T) return ReadAttribute<uint64_t>;
+	return nullptr;
+}
+
+
+template <typename T>
+static bool ParseAttribute(const std::string &text, void* location) {
+	size_t end;
+	T value;
+	try {
+		if (std::is_floating_point<T>::value) {
+			value = static_cast<T>(std::stold(text, &end));
+		} else if (std::is_signed<T>::value) {
+			long long parsed = std::stoll(text, &end);
+			if (parsed < std::numeric_limits<T>::min() || parsed > std::numeric_limits<T>::max())
+				return false;
+			value = static_cast<T>(parsed);
+		} else {
+			unsigned long long parsed = std::stoull(text, &end);
+			if (text[0] == '-' || parsed > std::numeric_limits<T>::max())
+				return false;
+			value = static_cast<T>(parsed);
+		}
+	} catch (const std::exception&) {
+		return false;
+	}
+	if (end != text.size())
+		return false;
+	*static_cast<T*>(location) = value;
+	return true;
+}
+
+
+static bool ParseBoolAttribute(const std::string &text, void* location) {
+	if (text != "true" && text != "false" && text != "1" && text != "0")
+		return false;
+	*static_cast<bool*>(location) = (text == "true" || text == "1");
+	return true;
+}
+
+
+AttributeParser GetAttributeParser(MPI_Datatype datatype) {
+	if (datatype == MPI_DOUBLE) return ParseAttribute<double>;
+	if (datatype == MPI_FLOAT) return ParseAttribute<float>;
+	if (datatype == MPI_LONG_DOUBLE) return ParseAttribute<long double>;
+	if (datatype == MPI_CHAR || datatype == MPI_SIGNED_CHAR || datatype == MPI_INT8_T) return ParseAttribute<int8_t>;
+	if (datatype == MPI_SHORT || datatype == MPI_INT16_T) return ParseAttribute<int16_t>;
+	if (datatype == MPI_INT || datatype == MPI_INT32_T) return ParseAttribute<int32_t>;
+	if (datatype == MPI_LONG || datatype == MPI_LONG_LONG || datatype == MPI_LONG_LONG_INT || datatype == MPI_INT64_T) return ParseAttribute<int64_t>;
+	if (datatype == MPI_UNSIGNED_CHAR || datatype == MPI_UINT8_T) return ParseAttribute<uint8_t>;
+	if (datatype == MPI_CXX_BOOL || datatype == MPI_C_BOOL) return ParseBoolAttribute;
+	if (datatype == MPI_UNSIGNED_SHORT || datatype == MPI_UINT16_T) return ParseAttribute<uint16_t>;
+	if (datatype == MPI_UNSIGNED || datatype == MPI_UINT32_T) return ParseAttribute<uint32_t>;
+	if (datatype == MPI_UNSIGNED_LONG || datatype == MPI_UNSIGNED_LONG_LONG || datatype == MPI_UINT64_T) return ParseAttribute<uint64_t>;
+	return nullptr;
+}
@@ -7,11 +7,15 @@
 #define TYPES_HPP_
 
 #include <vector>
+#include <string>
 #include <cstdint>
 #include <memory>
 #include <stdexcept>
 #include <unordered_map>
 #include <unordered_set>
+#include <atomic>
+#include <chrono>
+#include <limits>
 #include <mpi.h>
 
 #include "utils.hpp"
@@ -56,6 +60,7 @@ typedef std::unordered_map<std::pair<AgentId, AgentType>, std::unique_ptr<Agent>
 // Names
 typedef std::string AgentName;
 typedef std::string AttributeName;
+typedef std::string InteractionName;
 
 // Time step
 typedef uint64_t Time;
@@ -107,9 +112,452 @@ typedef struct _MetaEvolutionDescription {
 
 void generateMPIDatatype(MPI_Datatype &type);
 
+/// Number of times IdleBcast tests its broadcast before starting to sleep.
+const int IDLE_SPIN_TESTS = 100;
+
+/// First and maximal sleep duration (in microseconds) between two tests of
+/// IdleBcast.
+const int IDLE_MIN_SLEEP = 50;
+const int IDLE_MAX_SLEEP = 10000;
+
+/**
+ * \fn void IdleBcast(void* buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm)
+ * \brief Same as MPI_Bcast, but sleeps while waiting for the broadcast so that
+ *        a process waiting for an order does not use any CPU.
+ * \details The broadcast is an MPI_Ibcast tested IDLE_SPIN_TESTS times, then
+ * between sleeps doubling from IDLE_MIN_SLEEP to IDLE_MAX_SLEEP, so that orders
+ * sent in quick succession are received without delay.
+ * \warning Since nonblocking collectives do not match blocking ones, all the
+ * processes of comm must use IdleBcast for the same broadcast.
+ */
+void IdleBcast(void* buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm);
+
+/**
+ * \struct TrafficCounters
+ * \brief Counts the interactions exchanged and the public attributes read
+ *        between an agent and the agents held by each master.
+ */
+struct TrafficCounters {
+	/// Traffic with agents held by the master of the agent.
+	uint64_t local = 0;
+
+	/// Traffic with agents held by other masters.
+	std::unordered_map<MasterId, uint64_t> remote;
+};
+
+/**
+ * \struct RmaRequest
+ * \brief One-sided operation submitted by an agent handler to the
+ *        communication thread of its master.
+ */
+struct RmaRequest {
+	/// MPI_Get if true, MPI_Put otherwise.
+	bool get = false;
+
+	/// Local buffer of the operation (puts only, the communication thread
+	/// allocates the buffers of the gets).
+	void* location = nullptr;
+
+	/// Size of the transferred value.
+	size_t size = 0;
+
+	/// MPI type of the transferred value.
+	MPI_Datatype datatype = MPI_DATATYPE_NULL;
+
+	/// Master whose window is accessed.
+	MasterId target = 0;
+
+	/// Displacement of the value in the window of target.
+	size_t target_disp = 0;
+
+	/// Set to the buffer of the value once it can be read (gets only, nullptr
+	/// for puts).
+	std::atomic<void*>* result = nullptr;
+};
+
+/**
+ * \enum Phase
+ * \brief Phases of a time step, timed separately in the statistics.
+ */
+enum class Phase {
+	META_EVOLUTION,
+	UPDATE_PUBLIC_ATTRIBUTES,
+	REPLICATION,
+	SEND_RECEIVE_INTERACTIONS,
+	DISTRIBUTE_INTERACTIONS,
+	BEHAVIORS,
+	BALANCING,
+	PROBES,
+	SYNCHRONIZATION,
+
+	/// Number of phases (not a phase).
+	NB_PHASES
+};
+
+/// Number of phases of a time step.
+const size_t NB_PHASES = static_cast<size_t>(Phase::NB_PHASES);
+
+/// Names of the phases, in the order of Phase.
+const char* const PHASES_NAMES[NB_PHASES] = {"meta_evolution", "update_public_attributes",
+	"replication", "send_receive_interactions", "distribute_interactions", "behaviors",
+	"balancing", "probes", "synchronization"};
+
+/**
+ * \enum SyncPoint
+ * \brief Calls of Synchronize in a time step, whose waits are timed
+ *        separately in the statistics (their sum being the phase
+ *        SYNCHRONIZATION).
+ */
+enum class SyncPoint {
+	AFTER_META_EVOLUTION,
+	AFTER_UPDATE_PUBLIC_ATTRIBUTES,
+	AFTER_SEND_RECEIVE_INTERACTIONS,
+	AFTER_DISTRIBUTE_INTERACTIONS,
+	END_OF_STEP,
+
+	/// Number of synchronization points (not a synchronization point).
+	NB_SYNC_POINTS
+};
+
+/// Number of calls of Synchronize in a time step.
+const size_t NB_SYNC_POINTS = static_cast<size_t>(SyncPoint::NB_SYNC_POINTS);
+
+/// Names of the synchronization points, in the order of SyncPoint.
+const char* const SYNC_POINTS_NAMES[NB_SYNC_POINTS] = {"sync_meta_evolution",
+	"sync_update_public_attributes", "sync_send_receive_interactions",
+	"sync_distribute_interactions", "sync_end_of_step"};
+
+/**
+ * \enum AttributeAccess
+ * \brief Counters of the reads of attributes by Master::GetAttribute, in the
+ *        attributes access profile.
+ */
+enum class AttributeAccess {
+	/// Reads of critical attributes, in the critical window of the node.
+	CRITICAL,
+
+	/// Reads of public attributes of agents of the reading master.
+	LOCAL,
+
+	/// Reads of public attributes of agents of another master of the same
+	/// node, through shared memory.
+	COLOCATED,
+
+	/// Reads of public attributes of remote agents already received during
+	/// the time step.
+	CACHE_HIT,
+
+	/// Reads of public attributes of remote agents replicated on the reading
+	/// master.
+	REPLICA,
+
+	/// Reads of public attributes of remote agents which required an MPI_Get.
+	CACHE_MISS,
+
+	/// Remote agents whose attribute was read, counted once per time step.
+	DISTINCT_REMOTE_AGENTS,
+
+	/// Number of counters (not a counter).
+	NB_ATTRIBUTE_ACCESSES
+};
+
+/// Number of counters of each attribute in the attributes access profile.
+const size_t NB_ATTRIBUTE_ACCESSES = static_cast<size_t>(AttributeAccess::NB_ATTRIBUTE_ACCESSES);
+
+/// Names of the counters of the attributes access profile, in the order of
+/// AttributeAccess.
+const char* const ATTRIBUTE_ACCESSES_NAMES[NB_ATTRIBUTE_ACCESSES] = {"critical",
+	"local", "colocated", "cache_hit", "replica", "cache_miss", "distinct_remote_agents"};
+
+/**
+ * \struct StepStatistics
+ * \brief Performance counters of a master over one or several time steps.
+ * \details Only made of doubles, so that it can be sent as an array of
+ * STEP_STATISTICS_SIZE MPI_DOUBLE.
+ */
+struct StepStatistics {
+	/// Time spent in each phase, in seconds.
+	double phases[NB_PHASES] = {};
+
+	/// Time spent waiting in each call of Synchronize, in seconds.
+	double synchronizations[NB_SYNC_POINTS] = {};
+
+	/// Number of interactions sent to and received from other masters.
+	double interactions_sent = 0;
+	double interactions_received = 0;
+
+	/// Bytes of the interactions sent and received.
+	double bytes_sent = 0;
+	double bytes_received = 0;
+
+	/// Number and bytes of the MPI_Get and MPI_Put made by the master.
+	double gets = 0;
+	double puts = 0;
+	double rma_bytes = 0;
+
+	/// Number of reads of public attributes, of which gets is the number of
+	/// cache misses.
+	double public_reads = 0;
+
+	/// Time taken by the slowest agent handler and average time of the agent
+	/// handlers, summed over their phases.
+	double handlers_max = 0;
+	double handlers_mean = 0;
+
+	StepStatistics& operator+= (const StepStatistics &other) {
+		double* values = reinterpret_cast<double*>(this);
+		const double* other_values = reinterpret_cast<const double*>(&other);
+		for (size_t i=0; i<sizeof(StepStatistics)/sizeof(double); i++) {
+			values[i] += other_values[i];
+		}
+		return *this;
+	}
+};
+
+/// Number of doubles in a StepStatistics.
+const int STEP_STATISTICS_SIZE = sizeof(StepStatistics)/sizeof(double);
+
+/**
+ * \struct TraceEvent
+ * \brief Span of time recorded by the tracing mode of the masters.
+ */
+struct TraceEvent {
+	/// Name of the traced operation (a string literal).
+	const char* name = nullptr;
+
+	/// Times at which the operation started and ended.
+	std::chrono::steady_clock::time_point begin;
+	std::chrono::steady_clock::time_point end;
+};
+
+/**
+ * \enum Aggregation
+ * \brief Operations computed by Master::Aggregate over an attribute of all the
+ *        agents of a type.
+ */
+enum class Aggregation {
+	COUNT,
+	SUM,
+	MEAN,
+	MIN,
+	MAX,
+	HISTOGRAM,
+
+	/// Number of aggregations (not an aggregation).
+	NB_AGGREGATIONS
+};
+
+/// Number of aggregations.
+const size_t NB_AGGREGATIONS = static_cast<size_t>(Aggregation::NB_AGGREGATIONS);
+
+/// Names of the aggregations, in the order of Aggregation.
+const char* const AGGREGATIONS_NAMES[NB_AGGREGATIONS] = {"count", "sum", "mean",
+	"min", "max", "histogram"};
+
+/**
+ * \struct AttributeAggregate
+ * \brief Partial aggregation of a numerical attribute over a set of agents.
+ * \details If histogram is not empty, Add also counts the values in its bins,
+ * which evenly split [lower, upper].
+ */
+struct AttributeAggregate {
+	double count = 0;
+	double sum = 0;
+	double min = std::numeric_limits<double>::infinity();
+	double max = -std::numeric_limits<double>::infinity();
+
+	double lower = 0;
+	double upper = 0;
+	std::vector<double> histogram;
+
+	void Add(double value) {
+		count++;
+		sum += value;
+		min = value < min ? value : min;
+		max = value > max ? value : max;
+		if (!histogram.empty()) {
+			double width = (upper - lower)/histogram.size();
+			size_t bin = width > 0 ? static_cast<size_t>((value - lower)/width) : 0;
+			histogram[bin < histogram.size() ? bin : histogram.size()-1]++;
+		}
+	}
+
+	AttributeAggregate& operator+= (const AttributeAggregate &other) {
+		count += other.count;
+		sum += other.sum;
+		min = other.min < min ? other.min : min;
+		max = other.max > max ? other.max : max;
+		for (size_t i=0; i<histogram.size() && i<other.histogram.size(); i++) {
+			histogram[i] += other.histogram[i];
+		}
+		return *this;
+	}
+};
+
+/**
+ * \struct ProbeDescription
+ * \brief Aggregation of an attribute over all the agents of a type, evaluated
+ *        periodically by the masters (see Master::AddProbe).
+ */
+struct ProbeDescription {
+	AgentType type;
+	Attribute attribute;
+	Aggregation op;
+
+	/// Number of time steps between two evaluations.
+	Time period;
+};
+
+/**
+ * \struct ProbeFileHeader
+ * \brief Header of the file of a probe, followed by its records.
+ * \details The names are null-padded, and truncated to leave at least one
+ * null character. The size of the header is a multiple of the size of a
+ * record.
+ */
+struct ProbeFileHeader {
+	/// "ASSAPROB"
+	char magic[8];
+
+	/// Number of time steps between two evaluations.
+	Time period;
+
+	/// Name of the aggregation, in AGGREGATIONS_NAMES.
+	char op[16];
+
+	/// Name of the agent type.
+	char type[64];
+
+	/// Name of the attribute.
+	char attribute[64];
+};
+
+/// Function converting the value of an attribute to a double.
+typedef double (*AttributeReader)(const void* location);
+
+/**
+ * \fn AttributeReader GetAttributeReader(MPI_Datatype datatype)
+ * \brief Returns the function reading an attribute of MPI type datatype as a
+ *        double.
+ * \param datatype MPI type of the attribute, as in attributes_MPI_types_.
+ * \return The reader of the attribute, or nullptr if datatype is not an
+ *         arithmetic type.
+ */
+AttributeReader GetAttributeReader(MPI_Datatype datatype);
+
+/// Function writing at location the value of an attribute given as text,
+/// returning whether the text is valid.
+typedef bool (*AttributeParser)(const std::string &text, void* location);
+
+/**
+ * \fn AttributeParser GetAttributeParser(MPI_Datatype datatype)
+ * \brief Returns the function writing an attribute of MPI type datatype from
+ *        its text representation.
+ * \param datatype MPI type of the attribute, as in attributes_MPI_types_.
+ * \return The parser of the attribute, or nullptr if datatype is not an
+ *         arithmetic type.
+ */
+AttributeParser GetAttributeParser(MPI_Datatype datatype);
+
+/**
+ * \struct AttributeModification
+ * \brief New value of an attribute of an agent, given as text (see
+ *        Master::ModifyAttributes).
+ */
+struct AttributeModification {
+	AgentId agent_id;
+	AgentType agent_type;
+	Attribute attribute;
+	std::string value;
+};
+
 // Description of a window (public or private)
 typedef struct _WindowDescription {
       size_t size;
       size_t used;
 } WindowDescription;
+
+/**
+ * \struct AgentEdge
+ * \brief Weighted edge of the interaction graph between two initial agents.
+ * \details The extremities of the edge are given by their indices in the
+ * vector of initial agents. The graph is considered undirected.
+ */
+struct AgentEdge {
+	/// Index of the first agent in the vector of initial agents.
+	size_t source;
+
+	/// Index of the second agent in the vector of initial agents.
+	size_t target;
+
+	/// Expected amount of traffic between the two agents.
+	uint64_t weight;
+};
+
+/**
+ * \struct AttributeLink
+ * \brief Rule deriving edges of the interaction graph from an attribute.
+ * \details Every agent of type 'type' is linked to the agent of type
+ * 'target_type' whose local identifier is the value of its (integer) attribute
+ * 'attribute'.
+ */
+struct AttributeLink {
+	/// Type identifier of the agents holding the attribute.
+	AgentType type;
+
+	/// Attribute identifier of the attribute containing the target id.
+	Attribute attribute;
+
+	/// Type identifier of the agents which are targeted.
+	AgentType target_type;
+
+	/// Weight of each derived edge.
+	uint64_t weight;
+};
+
+/**
+ * \enum PlacementHeuristic
+ * \brief Heuristics which can be used to assign the initial agents to masters.
+ */
+enum class PlacementHeuristic {
+	/// Graph heuristic if an interaction graph or weights are given, naive
+	/// heuristic otherwise.
+	Automatic,
+
+	/// Same number of agents on each master, in the order of the instance.
+	Naive,
+
+	/// Partition of the interaction graph.
+	Graph,
+
+	/// Ranges of the Hilbert curve of the coordinates of the agents.
+	Hilbert,
+
+	/// Ranges of the Morton (Z-order) curve of the coordinates of the agents.
+	Morton
+};
+
+/**
+ * \struct PlacementDescription
+ * \brief Optional description of the interaction graph and of the positions
+ *        of the initial agents, read from the instance file and used to choose
+ *        their masters.
+ */
+struct PlacementDescription {
+	/// Explicit edges of the interaction graph.
+	std::vector<AgentEdge> edges;
+
+	/// Rules deriving edges from the attributes of the agents.
+	std::vector<AttributeLink> attribute_links;
+
+	/// Weight of the agents of each type (1 if absent), used for balancing.
+	std::unordered_map<AgentType, uint64_t> type_weights;
+
+	/// Heuristic used to assign the agents to masters.
+	PlacementHeuristic heuristic = PlacementHeuristic::Automatic;
+
+	/// Attributes giving the position of the agents of each type, used by the
+	/// space-filling curve heuristics.
+	std::unordered_map<AgentType, std::vector<Attribute>> coordinates;
+};
 #endif
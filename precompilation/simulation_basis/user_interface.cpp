@@ -8,6 +8,7 @@
 
 #include <iostream>
 #include <fstream>
+#include <iterator>
 #include <sstream>
 #include <vector>
 #include <cstdlib>
@@ -17,6 +18,8 @@
 #include <thread>
 
 #include "libs/ubjsoncpp/include/stream_writer.hpp"
+#include "utils/bulk_channel.hpp"
+#include "libs/jeayeson/include/jeayeson/jeayeson.hpp"
 
 #include <readline/readline.h>
 #include <readline/history.h>
@@ -24,6 +27,9 @@
 #include "user_interface_model.hpp"
 #include "user_interface.hpp"
 #include "master.hpp"
+#include "agent.hpp"
+#include "parameters_generation.hpp"
+#include "heuristics.hpp"
 
 // Control variable
 Control control = Control::IDLE;
@@ -32,10 +38,13 @@ Control control = Control::IDLE;
 std::unique_ptr<Master> master;
 
 std::unique_ptr<boost::interprocess::message_queue> mq_orders;
+// Channel of the payloads of the commands, opened next to mq_orders
+std::unique_ptr<utils::bulk_channel> bulk_channel;
 const char *done_cmd = "done";
 const char *error_cmd = "error";
 std::string mq_name;
 bool run;
+bool headless = false;
 
 void MasterHandler(int rank) {
 
@@ -67,14 +76,14 @@ void MasterHandler(int rank) {
 				break;
 		}
 		// Waits for a control from process 0
-		MPI_Bcast(&control, 1, MPI_INT, 0, MPI_COMM_WORLD);
+		IdleBcast(&control, 1, MPI_INT, 0, MPI_COMM_WORLD);
 
 	}
 
 }
 
 
-void Parse(const char* buffer, Control &control, int &nb_threads, int &nb_masters, bool &is_alive) {
+bool Parse(const char* buffer, Control &control, int &nb_threads, int &nb_masters, bool &is_alive) {
 
 	std::istringstream input(buffer);
 	std::string command; input >> command;
@@ -83,20 +92,30 @@ void Parse(const char* buffer, Control &control, int &nb_threads, int &nb_master
 		if (is_alive) {
 			master->KillSimulation();
 		}
-		MPI_Bcast(&control, 1, MPI_INT, 0, MPI_COMM_WORLD);
+		IdleBcast(&control, 1, MPI_INT, 0, MPI_COMM_WORLD);
 	} else if (command == "init") {
+		std::string file; input >> file;
+		// FIXME: Uncomment Instanciate when it is done
+		std::vector<void*> instanciation;// = Instanciate(file);
+		PlacementDescription placement;
+		// The instance is read before the other masters are involved, so that
+		// an invalid instance leaves the simulation unchanged
+		if (file != "") {
+			try {
+				instanciation = Instanciate(file);
+				placement = InstanciatePlacement(file, instanciation);
+			} catch (const InstanciateException &e) {
+				std::cerr << "Invalid instance " << file << ": " << e.what() << std::endl;
+				return false;
+			}
+		}
 		control = Control::INIT;
 		if (is_alive) {
 			master->KillSimulation();
 			master.reset();
 		}
-		MPI_Bcast(&control, 1, MPI_INT, 0, MPI_COMM_WORLD);
-		std::string file; input >> file;
-		// FIXME: Uncomment Instanciate when it is done
-		std::vector<void*> instanciation;// = Instanciate(file);
-		if (file != "")
-			instanciation = Instanciate(file);
-		master = std::make_unique<Master>(0, nb_masters, nb_threads, instanciation);
+		IdleBcast(&control, 1, MPI_INT, 0, MPI_COMM_WORLD);
+		master = std::make_unique<Master>(0, nb_masters, nb_threads, instanciation, placement);
 		is_alive = true;
 		// Freeing of the initialisation
 		// FIXME: make the free work
@@ -109,14 +128,19 @@ void Parse(const char* buffer, Control &control, int &nb_threads, int &nb_master
 			int n_steps;
 			if (input >> n_steps) {
 				// Run for the number of steps specified
-				for (int k = 0; k<n_steps; k++)
-					master->RunSimulation();
+				if (n_steps > 0)
+					master->RunBatch(n_steps);
+			}
+			else if (headless) {
+				std::cerr << error_headless_run;
+				return false;
 			}
 			else {
 				run = true;
 			}
 		} else {
 			std::cerr << error_init;
+			return false;
 		}
 
 	} else if (command == "pause") {
@@ -124,22 +148,44 @@ void Parse(const char* buffer, Control &control, int &nb_threads, int &nb_master
 	} else if (command == "kill") {
 		if (is_alive) {
 			master->KillSimulation();
+			master->WaitExport();
 			is_alive = false;
 		}
 	} else if (command == "set_period") {
 		if (is_alive) {
 			Time new_period; input >> new_period;
 			master->ChangePeriod(new_period);
+		} else {
+			std::cerr << error_init;
+			return false;
 		}
 	} else if (command == "set_nb_threads") {
+		std::string value; input >> value;
+		int new_nb_threads = Master::AUTO_AGENT_HANDLERS;
+		if (value != "auto") {
+			try {
+				new_nb_threads = std::stoi(value);
+			} catch (const std::exception&) {
+				new_nb_threads = 0;
+			}
+			if (new_nb_threads <= 0) {
+				std::cerr << "The number of threads must be a positive integer or 'auto'.\n";
+				return false;
+			}
+		}
 		if (is_alive) {
-			std::cerr << error_reset;
+			// The running simulation changes its number of agent handlers between
+			// two time steps
+			master->ChangeNbAgentHandlers(new_nb_threads);
+		} else if (value == "auto") {
+			std::cerr << error_init;
+			return false;
 		} else {
 			// Sending the command
 			control = Control::CHANGE_NB_THREADS;
-			MPI_Bcast(&command, 1, MPI_INT, 0, MPI_COMM_WORLD);
+			IdleBcast(&control, 1, MPI_INT, 0, MPI_COMM_WORLD);
 			// Sending the new number of threads
-			input >> nb_threads;
+			nb_threads = new_nb_threads;
 			MPI_Bcast(&nb_threads, 1, MPI_INT, 0, MPI_COMM_WORLD);
 		}
 	} else if (command == "export_json") {
@@ -151,6 +197,212 @@ void Parse(const char* buffer, Control &control, int &nb_threads, int &nb_master
 			file.close();
 		} else {
 			std::cerr << error_init;
+			return false;
+		}
+	} else if (command == "export_json_async") {
+		if (is_alive) {
+			std::string output; input >> output;
+			return master->ExportSimulationAsync(output);
+		} else {
+			std::cerr << error_init;
+			return false;
+		}
+	} else if (command == "stats") {
+		if (is_alive) {
+			Time nb_steps = 0; input >> nb_steps;
+			ubjson::Value statistics = master->GetStatistics(nb_steps);
+			// A single line in headless mode, so that the output stays one json
+			// value per line
+			std::cout << ubjson::to_ostream(statistics,
+				headless ? ubjson::to_ostream::compact : ubjson::to_ostream::pretty) << std::endl;
+		} else {
+			std::cerr << error_init;
+			return false;
+		}
+	} else if (command == "timings") {
+		if (is_alive) {
+			Time nb_steps = 0; input >> nb_steps;
+			ubjson::Value timings = master->GetPhaseTimings(nb_steps);
+			std::cout << ubjson::to_ostream(timings,
+				headless ? ubjson::to_ostream::compact : ubjson::to_ostream::pretty) << std::endl;
+		} else {
+			std::cerr << error_init;
+			return false;
+		}
+	} else if (command == "traffic") {
+		if (is_alive) {
+			std::string output;
+			if (!(input >> output)) {
+				std::cerr << "Usage: traffic <file.json|file.csv> [number_of_steps]\n";
+				return false;
+			}
+			Time nb_steps = 0; input >> nb_steps;
+			ubjson::Value traffic = master->GetTrafficMatrix(nb_steps);
+			std::ofstream file(output);
+			if (output.size() >= 4 && output.substr(output.size()-4) == ".csv") {
+				WriteTrafficCsv(traffic, file);
+			} else {
+				file << ubjson::to_ostream(traffic, ubjson::to_ostream::pretty) << std::endl;
+			}
+			if (!file) {
+				std::cerr << "Cannot write " << output << std::endl;
+				return false;
+			}
+		} else {
+			std::cerr << error_init;
+			return false;
+		}
+	} else if (command == "aggregate") {
+		if (is_alive) {
+			std::pair<AgentType, Attribute> attribute;
+			Aggregation op;
+			if (!ParseAggregation(input, attribute, op)) {
+				return false;
+			}
+			size_t nb_bins;
+			if (!(input >> nb_bins)) {
+				nb_bins = AGGREGATE_HISTOGRAM_BINS;
+			} else if (nb_bins == 0) {
+				std::cerr << "A histogram needs at least one bin.\n";
+				return false;
+			}
+			ubjson::Value result = master->Aggregate(attribute.first, attribute.second, op, nb_bins);
+			if (result.isNull()) {
+				return false;
+			}
+			std::cout << ubjson::to_ostream(result,
+				headless ? ubjson::to_ostream::compact : ubjson::to_ostream::pretty) << std::endl;
+		} else {
+			std::cerr << error_init;
+			return false;
+		}
+	} else if (command == "probe") {
+		if (is_alive) {
+			std::pair<AgentType, Attribute> attribute;
+			Aggregation op;
+			if (!ParseAggregation(input, attribute, op)) {
+				return false;
+			}
+			Time period = 0;
+			std::string file;
+			input >> period >> file;
+			if (!master->AddProbe(attribute.first, attribute.second, op, period, file)) {
+				return false;
+			}
+		} else {
+			std::cerr << error_init;
+			return false;
+		}
+	} else if (command == "probe_clear") {
+		if (is_alive) {
+			master->ClearProbes();
+		} else {
+			std::cerr << error_init;
+			return false;
+		}
+	} else if (command == "add_agents" || command == "modify_attributes") {
+		std::string file; input >> file;
+		std::string payload;
+		std::ostringstream reply;
+		// The payload is always read, so that the bulk channel stays
+		// synchronized with the command line interface
+		bool ok = ReadBulk(file, payload);
+		if (ok && !is_alive) {
+			std::cerr << error_init;
+			ok = false;
+		}
+		if (ok && command == "add_agents") {
+			try {
+				std::vector<void*> agents = InstanciateData(payload);
+				ubjson::Value ids = master->AddUserAgents(agents);
+				for (auto &agent : agents) {
+					free(agent);
+				}
+				reply << ubjson::to_ostream(ids, ubjson::to_ostream::compact);
+			} catch (const InstanciateException &e) {
+				std::cerr << "Invalid agents " << file << ": " << e.what() << std::endl;
+				ok = false;
+			}
+		} else if (ok) {
+			std::vector<AttributeModification> modifications;
+			ok = ParseModifications(payload, modifications);
+			if (ok) {
+				reply << "{\"modified\":" << master->ModifyAttributes(modifications) << "}";
+			}
+		}
+		WriteBulk("", reply.str(), ok);
+		return ok;
+	} else if (command == "fetch_json" || command == "probe_fetch") {
+		std::string file; input >> file;
+		std::ostringstream content;
+		if (is_alive && command == "fetch_json") {
+			content << ubjson::to_ostream(master->ExportSimulation(), ubjson::to_ostream::pretty) << std::endl;
+		} else if (is_alive) {
+			content << ubjson::to_ostream(master->TakeProbesRecords(), ubjson::to_ostream::compact) << std::endl;
+		} else {
+			std::cerr << error_init;
+		}
+		WriteBulk(file, content.str(), is_alive);
+		return is_alive;
+	} else if (command == "attributes_profile") {
+		if (is_alive) {
+			std::string mode; input >> mode;
+			if (mode == "on" || mode == "off") {
+				master->SetAttributesProfiling(mode == "on");
+			} else {
+				std::cerr << "The attributes profiling mode must be 'on' or 'off'.\n";
+				return false;
+			}
+		} else {
+			std::cerr << error_init;
+			return false;
+		}
+	} else if (command == "attributes_profile_dump") {
+		if (is_alive) {
+			std::string output;
+			if (!(input >> output)) {
+				std::cerr << "Usage: attributes_profile_dump <file.json|file.csv>\n";
+				return false;
+			}
+			ubjson::Value profile = master->GetAttributesProfile();
+			std::ofstream file(output);
+			if (output.size() >= 4 && output.substr(output.size()-4) == ".csv") {
+				WriteAttributesProfileCsv(profile, file);
+			} else {
+				file << ubjson::to_ostream(profile, ubjson::to_ostream::pretty) << std::endl;
+			}
+			if (!file) {
+				std::cerr << "Cannot write " << output << std::endl;
+				return false;
+			}
+		} else {
+			std::cerr << error_init;
+			return false;
+		}
+	} else if (command == "trace") {
+		if (is_alive) {
+			std::string mode; input >> mode;
+			if (mode == "on" || mode == "off") {
+				master->SetTracing(mode == "on");
+			} else {
+				std::cerr << "The tracing mode must be 'on' or 'off'.\n";
+				return false;
+			}
+		} else {
+			std::cerr << error_init;
+			return false;
+		}
+	} else if (command == "trace_dump") {
+		if (is_alive) {
+			std::string output;
+			if (!(input >> output)) {
+				std::cerr << "Usage: trace_dump <file.json>\n";
+				return false;
+			}
+			return master->DumpTrace(output);
+		} else {
+			std::cerr << error_init;
+			return false;
 		}
 	} else if (command == "convert") {
 		if (is_alive) {
@@ -160,16 +412,240 @@ void Parse(const char* buffer, Control &control, int &nb_threads, int &nb_master
 			master->ConvertOutputToInput(in, out);
 		} else {
 			std::cerr << error_init;
+			return false;
 		}
 	} else if (std::find(model_commands.begin(), model_commands.end(), command) != model_commands.end()) {
 		// It is a model-specific command
-		ParseModelCommand(buffer, master, is_alive);
+		return ParseModelCommand(buffer, master, is_alive);
 	} else {
 		std::cerr << inv_com;
+		return false;
+	}
+	return true;
+}
+
+bool ReadBulk(const std::string &file, std::string &payload) {
+	if (bulk_channel) {
+		bulk_channel->receive(payload);
+		return true;
+	}
+	std::ifstream stream(file);
+	if (!stream) {
+		std::cerr << "Could not open the file " << file << ".\n";
+		return false;
+	}
+	payload.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+	return true;
+}
+
+
+void WriteBulk(const std::string &file, const std::string &content, bool ok) {
+	if (bulk_channel) {
+		bulk_channel->send(ok ? content : "");
+	} else if (ok && file == "") {
+		std::cout << content << std::endl;
+	} else if (ok) {
+		std::ofstream stream(file);
+		stream << content;
 	}
+}
 
+
+void WriteTrafficCsv(ubjson::Value &traffic, std::ostream &output) {
+	output << "source,destination,operation,type,count,bytes,steps\n";
+	ubjson::Value &entries = traffic["traffic"];
+	if (!entries.isArray()) {
+		return;
+	}
+	for (int i=0; i<(int)entries.size(); i++) {
+		ubjson::Value &entry = entries[i];
+		output << entry["source"].asInt() << "," << entry["destination"].asInt() << ","
+		       << entry["operation"].asString() << ","
+		       << (entry["type"].isString() ? entry["type"].asString() : "") << ","
+		       << entry["count"].asInt64() << "," << entry["bytes"].asInt64() << ","
+		       << traffic["steps"].asInt64() << "\n";
+	}
 }
 
+
+void WriteAttributesProfileCsv(ubjson::Value &profile, std::ostream &output) {
+	output << "reader,target,attribute";
+	for (size_t i=0; i<NB_ATTRIBUTE_ACCESSES; i++) {
+		output << "," << ATTRIBUTE_ACCESSES_NAMES[i];
+	}
+	output << ",steps\n";
+	ubjson::Value &entries = profile["accesses"];
+	if (!entries.isArray()) {
+		return;
+	}
+	for (int i=0; i<(int)entries.size(); i++) {
+		ubjson::Value &entry = entries[i];
+		output << entry["reader"].asString() << "," << entry["target"].asString() << ","
+		       << entry["attribute"].asString();
+		for (size_t j=0; j<NB_ATTRIBUTE_ACCESSES; j++) {
+			output << "," << entry[ATTRIBUTE_ACCESSES_NAMES[j]].asInt64();
+		}
+		output << "," << profile["steps"].asInt64() << "\n";
+	}
+}
+
+
+bool ParseModifications(const std::string &payload, std::vector<AttributeModification> &modifications) {
+	std::unordered_map<AgentType, AgentName> type_to_string;
+	std::unordered_map<AgentName, AgentType> string_to_type;
+	CreateAgentsNamesRelation(type_to_string, string_to_type);
+	AttributesNames attribute_to_string;
+	AttributesIds string_to_attribute;
+	CreateAttributesNamesRelation(attribute_to_string, string_to_attribute);
+
+	std::istringstream lines(payload);
+	std::string line;
+	while (std::getline(lines, line)) {
+		std::istringstream input(line);
+		std::string type_name, attribute_name;
+		AttributeModification modification;
+		if (!(input >> type_name) || type_name[0] == '#') {
+			continue;
+		}
+		if (!(input >> modification.agent_id >> attribute_name >> modification.value)) {
+			std::cerr << "Invalid modification: " << line << "\n";
+			return false;
+		}
+		auto attribute = string_to_attribute.find(std::make_pair(type_name, attribute_name));
+		if (attribute == string_to_attribute.end()) {
+			std::cerr << "The agent type " << type_name << " has no sendable attribute " << attribute_name << ".\n";
+			return false;
+		}
+		modification.agent_type = attribute->second.first;
+		modification.attribute = attribute->second.second;
+		modifications.push_back(std::move(modification));
+	}
+	return true;
+}
+
+
+bool ParseAggregation(std::istream &input, std::pair<AgentType, Attribute> &attribute, Aggregation &op) {
+	std::string type_name, attribute_name, op_name;
+	input >> type_name >> attribute_name >> op_name;
+	AttributesNames attribute_to_string;
+	AttributesIds string_to_attribute;
+	CreateAttributesNamesRelation(attribute_to_string, string_to_attribute);
+	auto it = string_to_attribute.find(std::make_pair(type_name, attribute_name));
+	if (it == string_to_attribute.end()) {
+		std::cerr << "The agent type " << type_name << " has no sendable attribute " << attribute_name << ".\n";
+		return false;
+	}
+	auto name = std::find_if(AGGREGATIONS_NAMES, AGGREGATIONS_NAMES + NB_AGGREGATIONS,
+		[&op_name](const char* aggregation) { return op_name == aggregation; });
+	if (name == AGGREGATIONS_NAMES + NB_AGGREGATIONS) {
+		std::cerr << "The aggregation must be count, sum, mean, min, max or histogram.\n";
+		return false;
+	}
+	attribute = it->second;
+	op = static_cast<Aggregation>(name - AGGREGATIONS_NAMES);
+	return true;
+}
+
+
+PlacementDescription InstanciatePlacement(std::string file, std::vector<void*> &agents) try {
+	PlacementDescription placement;
+	json_map map{json_file{file}};
+	if (!map.has("placement"))
+		return placement;
+	json_map &section = map["placement"].as<json_map>();
+
+	// Names of the types and attributes of the model
+	std::unordered_map<AgentType, AgentName> type_to_string;
+	std::unordered_map<AgentName, AgentType> string_to_type;
+	CreateAgentsNamesRelation(type_to_string, string_to_type);
+	AttributesNames attribute_to_string;
+	AttributesIds string_to_attribute;
+	CreateAttributesNamesRelation(attribute_to_string, string_to_attribute);
+	auto type_of = [&string_to_type](const std::string &name) {
+		auto it = string_to_type.find(name);
+		if (it == string_to_type.end())
+			throw InstanciateException("unknown agent type " + name + " in placement");
+		return it->second;
+	};
+	auto weight_of = [](json_map &entry) -> uint64_t {
+		return entry.has("weight") ? entry["weight"].as<json_int>() : 1;
+	};
+
+	// Position of each agent in the vector returned by Instanciate
+	std::unordered_map<std::pair<AgentId, AgentType>, size_t, hash_pair<AgentId, AgentType>> indices;
+	for (size_t k=0; k<agents.size(); k++) {
+		AgentStruct *agent = (AgentStruct*)agents.at(k);
+		indices.insert(std::make_pair(std::make_pair(agent->id, agent->type), k));
+	}
+	auto index_of = [&](json_map &agent) {
+		AgentType type = type_of(agent["type"].as<std::string>());
+		AgentId id = agent["id"].as<json_int>();
+		auto it = indices.find(std::make_pair(id, type));
+		if (it == indices.end())
+			throw InstanciateException("agent " + std::to_string(id) + " of type "
+				+ agent["type"].as<std::string>() + " in placement does not exist");
+		return it->second;
+	};
+
+	if (section.has("edges")) {
+		for (auto &edge : section["edges"].as<json_array>()) {
+			json_map &e = edge.as<json_map>();
+			placement.edges.push_back(AgentEdge{
+				index_of(e["source"].as<json_map>()), index_of(e["target"].as<json_map>()), weight_of(e)});
+		}
+	}
+	if (section.has("attribute_links")) {
+		for (auto &link : section["attribute_links"].as<json_array>()) {
+			json_map &l = link.as<json_map>();
+			std::string type = l["type"].as<std::string>();
+			std::string attribute = l["attribute"].as<std::string>();
+			auto it = string_to_attribute.find(std::make_pair(type, attribute));
+			if (it == string_to_attribute.end())
+				throw InstanciateException("unknown attribute " + attribute + " of type " + type + " in placement");
+			placement.attribute_links.push_back(AttributeLink{
+				it->second.first, it->second.second, type_of(l["target_type"].as<std::string>()), weight_of(l)});
+		}
+	}
+	if (section.has("weights")) {
+		for (auto &weight : section["weights"].as<json_map>()) {
+			placement.type_weights[type_of(weight.first)] = weight.second.as<json_int>();
+		}
+	}
+	if (section.has("heuristic")) {
+		std::string heuristic = section["heuristic"].as<std::string>();
+		if (heuristic == "automatic")
+			placement.heuristic = PlacementHeuristic::Automatic;
+		else if (heuristic == "naive")
+			placement.heuristic = PlacementHeuristic::Naive;
+		else if (heuristic == "graph")
+			placement.heuristic = PlacementHeuristic::Graph;
+		else if (heuristic == "hilbert")
+			placement.heuristic = PlacementHeuristic::Hilbert;
+		else if (heuristic == "morton")
+			placement.heuristic = PlacementHeuristic::Morton;
+		else
+			throw InstanciateException("unknown placement heuristic " + heuristic);
+	}
+	if (section.has("coordinates")) {
+		for (auto &type : section["coordinates"].as<json_map>()) {
+			std::vector<Attribute> &attributes = placement.coordinates[type_of(type.first)];
+			for (auto &attribute : type.second.as<json_array>()) {
+				std::string name = attribute.as<std::string>();
+				auto it = string_to_attribute.find(std::make_pair(type.first, name));
+				if (it == string_to_attribute.end())
+					throw InstanciateException("unknown attribute " + name + " of type " + type.first + " in placement");
+				attributes.push_back(it->second.second);
+			}
+		}
+	}
+	return placement;
+} catch (const InstanciateException &e) {
+	throw;
+} catch (const std::exception &e) {
+	throw InstanciateException(e);
+}
+
+
 void Listen() {
 	// Number of threads for each process
 	int nb_threads = 2;
@@ -185,14 +661,105 @@ void Listen() {
 	boost::interprocess::message_queue::size_type recvd_size;
 	unsigned int priority;
 	char buffer[1024];
+	// Number of periods run between two checks of the message queue in
+	// continuous run mode
+	Time batch = 1;
 	while (control != Control::EXIT) {
-		if (mq_orders->try_receive(buffer, 1024, recvd_size, priority)) {
+		if (!run) {
+			// Nothing to do until the next command: sleeps in the message queue
+			batch = 1;
+			mq_orders->receive(buffer, 1024, recvd_size, priority);
+			Parse(buffer, control, nb_threads, nb_masters, is_alive);
+		}
+		else if (mq_orders->try_receive(buffer, 1024, recvd_size, priority)) {
 			run = false;
 			Parse(buffer, control, nb_threads, nb_masters, is_alive);
 		}
-		else if (run)
-			master->RunSimulation();
+		else {
+			auto start = std::chrono::steady_clock::now();
+			master->RunBatch(batch);
+			std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+			batch = ChooseBatchSize(batch, elapsed.count());
+		}
+	}
+}
+
+
+int RunScript(const std::vector<std::string> &commands) {
+	int nb_threads = 2;
+	int nb_masters;
+	MPI_Comm_size(MPI_COMM_WORLD, &nb_masters);
+	bool is_alive = false;
+
+	int status = EXIT_SUCCESS;
+	for (auto &line : commands) {
+		std::istringstream input(line);
+		std::string command;
+		// Empty lines and comments are skipped
+		if (!(input >> command) || command[0] == '#') {
+			continue;
+		}
+		auto start = std::chrono::steady_clock::now();
+		bool success;
+		try {
+			success = Parse(line.c_str(), control, nb_threads, nb_masters, is_alive);
+		} catch (const std::exception &e) {
+			std::cerr << "Error while executing '" << line << "': " << e.what() << std::endl;
+			success = false;
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		std::string escaped_line;
+		for (char c : line) {
+			if (c == '"' || c == '\\') {
+				escaped_line += '\\';
+			}
+			escaped_line += c;
+		}
+		std::cout << "{\"command\":\"" << escaped_line << "\",\"status\":\"" << (success ? "ok" : "error")
+		          << "\",\"seconds\":" << elapsed.count() << "}" << std::endl;
+		if (!success) {
+			status = EXIT_COMMAND_FAILED;
+			break;
+		}
+		if (control == Control::EXIT) {
+			return status;
+		}
+	}
+
+	// Stops the other processes
+	control = Control::EXIT;
+	if (is_alive) {
+		master->KillSimulation();
+	}
+	IdleBcast(&control, 1, MPI_INT, 0, MPI_COMM_WORLD);
+	return status;
+}
+
+
+int InitHeadlessInterface(std::string script, std::vector<std::string> commands) {
+	int rank;
+	MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+	headless = true;
+	if (rank != 0) {
+		MasterHandler(rank);
+		return EXIT_SUCCESS;
+	}
+	if (script != "") {
+		std::ifstream file(script);
+		if (!file) {
+			std::cerr << "The script " << script << " can not be read." << std::endl;
+			// The other processes are waiting for a control
+			control = Control::EXIT;
+			IdleBcast(&control, 1, MPI_INT, 0, MPI_COMM_WORLD);
+			return EXIT_INVALID_SCRIPT;
+		}
+		commands.clear();
+		std::string line;
+		while (std::getline(file, line)) {
+			commands.push_back(line);
+		}
 	}
+	return RunScript(commands);
 }
 
 
@@ -210,6 +777,8 @@ void InitUserInterface(std::string queue_id) {
 					(boost::interprocess::open_only
 					 ,mq_name.c_str()
 						);
+				bulk_channel = std::make_unique<utils::bulk_channel>(boost::interprocess::open_only,
+					mq_name + "_bulk");
 				Listen();
 			}
 			catch (boost::interprocess::interprocess_exception &ex){
@@ -8,6 +8,7 @@
 #define USER_INTERFACE_HPP_
 
 #include <string>
+#include <vector>
 #include <boost/interprocess/ipc/message_queue.hpp>
 #include "master.hpp"
 
@@ -34,6 +35,13 @@ enum class Control {
 	EXIT
 };
 
+// Exit codes of the headless mode
+/// Exit code of the headless mode when a command of the script failed.
+const int EXIT_COMMAND_FAILED = 1;
+
+/// Exit code of the headless mode when the script can not be read.
+const int EXIT_INVALID_SCRIPT = 2;
+
 // Error messages
 /// Error launched when the simulation has to be initiated to execute the command.
 const std::string error_init = "No simulation has been initiated. Execute first a 'init'.\n";
@@ -41,6 +49,9 @@ const std::string error_init = "No simulation has been initiated. Execute first
 /// Error launched when the simulation has to be cleared to execute the command.
 const std::string error_reset = "This can only be done once the simulation is cleared.\n";
 
+/// Error launched when a run without number of steps is asked in headless mode.
+const std::string error_headless_run = "The number of steps of 'run' is required in headless mode.\n";
+
 /// Error launched when the input command in not known.
 const std::string inv_com = "Invalid command. Enter help for more information.\n";
 
@@ -53,7 +64,7 @@ const std::string inv_com = "Invalid command. Enter help for more information.\n
 void MasterHandler(int rank);
 
 /**
- * \fn void Parse(const char* buffer, Control &control, int &nb_threads, int &nb_masters, bool &is_alive)
+ * \fn bool Parse(const char* buffer, Control &control, int &nb_threads, int &nb_masters, bool &is_alive)
  * \brief Parses the input of the command line and launches the corresponding
  *        orders.
  * \param buffer Content of the command line.
@@ -61,12 +72,129 @@ void MasterHandler(int rank);
  * \param nb_threads Reference to the nb_threads variable of process 0.
  * \param nb_masters Reference to the nb_masters variable of process 0.
  * \param is_alive Reference to the is_alive variable of process 0.
+ * \return false if the command is invalid or could not be executed, in which
+ *         case an error was printed.
+ */
+bool Parse(const char* buffer, Control &control, int &nb_threads, int &nb_masters, bool &is_alive);
+
+/**
+ * \fn bool ParseAggregation(std::istream &input, std::pair<AgentType, Attribute> &attribute, Aggregation &op)
+ * \brief Reads the names of an agent type, of one of its attributes and of an
+ *        aggregation, as given to the aggregate and probe commands.
+ * \param input Stream from which the names are read.
+ * \param attribute Set to the type and attribute identifiers.
+ * \param op Set to the aggregation.
+ * \return Whether the names are valid; otherwise an error is printed.
+ */
+bool ParseAggregation(std::istream &input, std::pair<AgentType, Attribute> &attribute, Aggregation &op);
+
+/**
+ * \fn PlacementDescription InstanciatePlacement(std::string file, std::vector<void*> &agents)
+ * \brief Reads the optional "placement" section of an instance file.
+ * \param file Path to the instance file.
+ * \param agents Reference to the vector of pointers to the AgentStructs
+ *        returned by Instanciate for the same file.
+ * \return The description of the interaction graph and positions of the
+ *         agents, empty if the file has no "placement" section.
+ * \details The section has the following (optional) entries:
+ *   - "edges": array of {"source": {"type": ..., "id": ...},
+ *     "target": {"type": ..., "id": ...}, "weight": ...};
+ *   - "attribute_links": array of {"type": ..., "attribute": ...,
+ *     "target_type": ..., "weight": ...}, linking each agent of type "type" to
+ *     the agent of type "target_type" whose id is the value of "attribute";
+ *   - "weights": map associating to an agent type the weight of its agents;
+ *   - "heuristic": "automatic" (default), "naive", "graph", "hilbert" or
+ *     "morton";
+ *   - "coordinates": map associating to an agent type the array of the names
+ *     of its numerical attributes giving its position, used by the "hilbert"
+ *     and "morton" heuristics.
+ *
+ * Weights of edges and links are 1 if absent.
+ * \note Throws an InstanciateException if the section is malformed.
+ */
+PlacementDescription InstanciatePlacement(std::string file, std::vector<void*> &agents);
+
+
+/**
+ * \fn bool ReadBulk(const std::string &file, std::string &payload)
+ * \brief Reads the payload of a command: received through the bulk channel
+ *        from the command line interface, which sends the content of its file,
+ *        or read from file in headless mode.
+ * \param file Path of the file given to the command.
+ * \param payload Set to the payload.
+ * \return Whether the payload could be read.
  */
-void Parse(const char* buffer, Control &control, int &nb_threads, int &nb_masters, bool &is_alive);
+bool ReadBulk(const std::string &file, std::string &payload);
+
+/**
+ * \fn void WriteBulk(const std::string &file, const std::string &content, bool ok)
+ * \brief Sends the result of a command: through the bulk channel to the
+ *        command line interface, which writes it to its file or prints it, or
+ *        written to file (printed if file is "") in headless mode.
+ * \param file Path of the file given to the command, or "".
+ * \param content Result of the command.
+ * \param ok Whether the command succeeded; otherwise an empty message is
+ *        sent, so that the command line interface is never left waiting.
+ */
+void WriteBulk(const std::string &file, const std::string &content, bool ok);
+
+/**
+ * \fn bool ParseModifications(const std::string &payload, std::vector<AttributeModification> &modifications)
+ * \brief Reads the modifications of the modify_attributes command, one per
+ *        line as "<type> <id> <attribute> <value>".
+ * \param payload Text of the modifications; empty lines and lines beginning
+ *        with '#' are ignored.
+ * \param modifications Vector to which the modifications are added.
+ * \return Whether all the lines are valid; otherwise an error is printed.
+ */
+bool ParseModifications(const std::string &payload, std::vector<AttributeModification> &modifications);
+
+/**
+ * \fn void WriteTrafficCsv(ubjson::Value &traffic, std::ostream &output)
+ * \brief Writes the traffic matrix returned by Master::GetTrafficMatrix in
+ *        CSV, one line per entry.
+ * \param traffic Reference to the traffic matrix.
+ * \param output Stream to which the CSV is written.
+ */
+void WriteTrafficCsv(ubjson::Value &traffic, std::ostream &output);
+
+/**
+ * \fn void WriteAttributesProfileCsv(ubjson::Value &profile, std::ostream &output)
+ * \brief Writes the attributes access profile returned by
+ *        Master::GetAttributesProfile in CSV, one line per read attribute.
+ * \param profile Reference to the attributes access profile.
+ * \param output Stream to which the CSV is written.
+ */
+void WriteAttributesProfileCsv(ubjson::Value &profile, std::ostream &output);
 
 
 void Listen();
 
+/**
+ * \fn int RunScript(const std::vector<std::string> &commands)
+ * \brief Executes commands one after the other on process 0, then stops the
+ *        simulation and the other processes.
+ * \param commands The commands, in the syntax of the command line interface;
+ *        empty lines and lines beginning with '#' are ignored.
+ * \return EXIT_SUCCESS, or EXIT_COMMAND_FAILED if a command failed, in which
+ *         case the following ones are not executed.
+ * \details For each executed command, prints on the standard output a json
+ * line {"command": ..., "status": "ok" or "error", "seconds": ...}.
+ */
+int RunScript(const std::vector<std::string> &commands);
+
+/**
+ * \fn int InitHeadlessInterface(std::string script, std::vector<std::string> commands)
+ * \brief Runs the simulation without command line interface: calls RunScript
+ *        on process 0 and MasterHandler on the others.
+ * \param script Path to a file containing one command per line, read on
+ *        process 0 only, or "" to execute commands.
+ * \param commands The commands to execute if script is "".
+ * \return The exit code of the process: the one of RunScript on process 0,
+ *         EXIT_INVALID_SCRIPT if script can not be read.
+ */
+int InitHeadlessInterface(std::string script, std::vector<std::string> commands);
+
 /**
  * \fn void InitUserInterface()
  * \brief Calls Listen on process 0 and MasterHandler on the others.
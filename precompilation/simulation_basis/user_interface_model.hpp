@@ -50,6 +50,15 @@ public:
  */
 std::vector<void*> Instanciate(std::string file);
 
+/**
+ * \fn std::vector<void*> InstanciateData(const std::string &json)
+ * \brief Same as Instanciate, but for an instance given as a JSON string.
+ * \param json Content of an instance file.
+ * \return A vector of pointers to the AgentStructs representing the agents
+ *         described in json.
+ */
+std::vector<void*> InstanciateData(const std::string &json);
+
 /// Model specific commands
 const std::vector<const char*> model_commands = {
 	"print_model",
@@ -57,8 +66,9 @@ const std::vector<const char*> model_commands = {
 };
 
 /**
- * Handle the model specific commands
+ * Handle the model specific commands, and returns whether the command
+ * succeeded
  */
-void ParseModelCommand(const char *buffer, std::unique_ptr<Master> &root_master, bool is_alive);
+bool ParseModelCommand(const char *buffer, std::unique_ptr<Master> &root_master, bool is_alive);
 
 #endif
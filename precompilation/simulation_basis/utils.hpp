@@ -11,6 +11,8 @@
 #include "utils/fixed_size_multibuffer.hpp"
 #include "utils/custom_heap.hpp"
 #include "utils/memory.hpp"
+#include "utils/mpsc_queue.hpp"
+#include "utils/ring_buffer.hpp"
 
 /**
  * \namespace utils
@@ -0,0 +1,167 @@
+/**
+ * \file bulk_channel.hpp
+ * \brief Implements channels exchanging large messages between two processes
+ *        through shared memory (utils::bulk_channel).
+ */
+
+#ifndef BULK_CHANNEL_HPP_
+#define BULK_CHANNEL_HPP_
+
+#include <string>    // std::string
+#include <cstring>   // std::memcpy
+#include <cstdint>   // uint64_t
+#include <algorithm> // std::min
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/interprocess_condition.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+
+
+namespace utils {
+
+	/**
+	 * \class bulk_channel
+	 *
+	 * \brief bulk_channel sends messages of any size between the process which
+	 * created it (the client) and the process which opened it (the server).
+	 *
+	 * \details The shared memory segment holds one ring buffer of capacity
+	 * bytes in each direction. A message is written as its size followed by its
+	 * content, chunk by chunk while the ring buffer has free space, so that a
+	 * message larger than the ring buffer is streamed while the other process
+	 * reads it. Messages are received in the order they were sent.
+	 *
+	 * Each side must be used by a single thread. Since send blocks while the
+	 * ring buffer is full, the other process must eventually receive the
+	 * message.
+	 *
+	 */
+	class bulk_channel { // Named the STL way
+
+	public:
+		// Types
+		typedef std::size_t size_type;
+
+
+		// Constructors
+		/// Creates the channel name, replacing any previous one (client side).
+		bulk_channel (boost::interprocess::create_only_t, const std::string &name, size_type capacity)
+			: name_{name}, owner_{true} {
+			// The headers of both ring buffers must stay aligned
+			capacity = (capacity + alignof(ring) - 1)/alignof(ring)*alignof(ring);
+			boost::interprocess::shared_memory_object::remove(name_.c_str());
+			segment_ = boost::interprocess::shared_memory_object(boost::interprocess::create_only,
+				name_.c_str(), boost::interprocess::read_write);
+			segment_.truncate(2*(sizeof(ring) + capacity));
+			region_ = boost::interprocess::mapped_region(segment_, boost::interprocess::read_write);
+			for (int i=0; i<2; i++) {
+				new (ring_at(i, capacity)) ring(capacity);
+			}
+			out_ = ring_at(0, capacity);
+			in_ = ring_at(1, capacity);
+		}
+
+		/// Opens the channel name created by the client (server side).
+		bulk_channel (boost::interprocess::open_only_t, const std::string &name)
+			: name_{name}, owner_{false} {
+			segment_ = boost::interprocess::shared_memory_object(boost::interprocess::open_only,
+				name_.c_str(), boost::interprocess::read_write);
+			region_ = boost::interprocess::mapped_region(segment_, boost::interprocess::read_write);
+			size_type capacity = static_cast<ring*>(region_.get_address())->capacity;
+			in_ = ring_at(0, capacity);
+			out_ = ring_at(1, capacity);
+		}
+
+		bulk_channel (const bulk_channel&) = delete;
+
+		bulk_channel& operator= (const bulk_channel&) = delete;
+
+		~bulk_channel () {
+			if (owner_) {
+				boost::interprocess::shared_memory_object::remove(name_.c_str());
+			}
+		}
+
+
+		/// Sends message to the other process, blocking while the ring buffer
+		/// is full.
+		void send (const std::string &message) {
+			uint64_t size = message.size();
+			write(reinterpret_cast<const char*>(&size), sizeof(size));
+			write(message.data(), message.size());
+		}
+
+		/// Receives the next message of the other process in message, blocking
+		/// until it is entirely received.
+		void receive (std::string &message) {
+			uint64_t size;
+			read(reinterpret_cast<char*>(&size), sizeof(size));
+			message.resize(size);
+			read(&message[0], size);
+		}
+
+	private:
+		/// Header of a ring buffer, followed by its capacity bytes.
+		struct ring {
+			explicit ring (size_type capacity) : capacity{capacity}, written{0}, read{0} {}
+			boost::interprocess::interprocess_mutex mutex;
+			boost::interprocess::interprocess_condition not_empty;
+			boost::interprocess::interprocess_condition not_full;
+			uint64_t capacity;
+			// Numbers of bytes written and read since the creation
+			uint64_t written;
+			uint64_t read;
+			char* data () { return reinterpret_cast<char*>(this + 1); }
+		};
+
+		ring* ring_at (int i, size_type capacity) {
+			return reinterpret_cast<ring*>(static_cast<char*>(region_.get_address()) + i*(sizeof(ring) + capacity));
+		}
+
+		void write (const char* data, size_type size) {
+			boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(out_->mutex);
+			while (size > 0) {
+				while (out_->written - out_->read == out_->capacity) {
+					out_->not_full.wait(lock);
+				}
+				size_type start = out_->written%out_->capacity;
+				size_type chunk = std::min({size, static_cast<size_type>(out_->capacity - (out_->written - out_->read)),
+					static_cast<size_type>(out_->capacity - start)});
+				std::memcpy(out_->data() + start, data, chunk);
+				out_->written += chunk;
+				data += chunk;
+				size -= chunk;
+				out_->not_empty.notify_one();
+			}
+		}
+
+		void read (char* data, size_type size) {
+			boost::interprocess::scoped_lock<boost::interprocess::interprocess_mutex> lock(in_->mutex);
+			while (size > 0) {
+				while (in_->written == in_->read) {
+					in_->not_empty.wait(lock);
+				}
+				size_type start = in_->read%in_->capacity;
+				size_type chunk = std::min({size, static_cast<size_type>(in_->written - in_->read),
+					static_cast<size_type>(in_->capacity - start)});
+				std::memcpy(data, in_->data() + start, chunk);
+				in_->read += chunk;
+				data += chunk;
+				size -= chunk;
+				in_->not_full.notify_one();
+			}
+		}
+
+		std::string name_;
+		bool owner_;
+		boost::interprocess::shared_memory_object segment_;
+		boost::interprocess::mapped_region region_;
+		ring* out_;
+		ring* in_;
+
+	};
+
+}
+
+#endif
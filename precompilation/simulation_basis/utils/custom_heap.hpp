@@ -11,6 +11,7 @@
 #include <cstddef>   // ptrdiff_t
 #include <cstdint>   // uint8_t
 #include <stdexcept> // std exceptions
+#include <vector>    // std::vector
 
 // TODO: Documentation
 
@@ -27,6 +28,9 @@ namespace utils {
 	 * used for the future memory allocations. this allows to effectively call
 	 * malloc very few times.
 	 *
+	 * The memory returned by allocate stays valid until clear is called: when
+	 * the heap grows, the previous buffer is only freed by clear.
+	 *
 	 */
 	class custom_heap { // Named the STL way
 
@@ -47,6 +51,7 @@ namespace utils {
 
 		~custom_heap () {
 			if (data_ != nullptr) free(data_);
+			for (auto &retired : retired_) free(retired);
 		}
 
 		void* allocate(size_type size) {
@@ -62,18 +67,17 @@ namespace utils {
 					size_ = size;
 					return data_;
 				} else {
+					// The previous buffer is kept until clear, since values
+					// were given in it
 					size_type new_capacity = capacity_*2;
-					if (size_+size > new_capacity) new_capacity = size_+size;
-					data_ = realloc(data_, new_capacity);
-					if (data_ == nullptr) {
-						size_ = 0;
-						capacity_ = 0;
-						throw std::runtime_error("Realloc failed");
-					}
+					if (size > new_capacity) new_capacity = size;
+					void* new_data = malloc(new_capacity);
+					if (new_data == nullptr) throw std::runtime_error("Malloc failed");
+					retired_.push_back(data_);
+					data_ = new_data;
 					capacity_ = new_capacity;
-					void* toReturn = (uint8_t*)data_+size_;
-					size_ += size;
-					return toReturn;
+					size_ = size;
+					return data_;
 				}
 			}
 		}
@@ -101,6 +105,8 @@ namespace utils {
 		}
 
 		void clear() {
+			for (auto &retired : retired_) free(retired);
+			retired_.clear();
 			size_ = 0;
 		}
 
@@ -139,6 +145,7 @@ namespace utils {
 		void* data_;
 		size_type size_;
 		size_type capacity_;
+		std::vector<void*> retired_;
 	};
 }
 
@@ -0,0 +1,122 @@
+/**
+ * \file mpsc_queue.hpp
+ * \brief Implements lock-free multiple producers single consumer queues
+ *        (utils::mpsc_queue).
+ */
+
+#ifndef MPSC_QUEUE_HPP_
+#define MPSC_QUEUE_HPP_
+
+#include <atomic>  // std::atomic
+#include <utility> // std::move
+
+
+namespace utils {
+
+	/**
+	 * \class mpsc_queue
+	 *
+	 * \brief mpsc_queue is a lock-free FIFO queue in which any number of
+	 * threads can push elements, while a single thread pops them.
+	 *
+	 * \details The queue is a linked list whose last node is swapped atomically
+	 * by the producers, so that push never blocks nor loops. An element pushed
+	 * may not be visible to the consumer until the producer finished linking
+	 * it: try_pop then returns false as if the queue was empty.
+	 *
+	 * The methods push may be called concurrently from any thread, whereas
+	 * try_pop and empty must only be called by the consumer thread.
+	 *
+	 */
+	template <class T>
+	class mpsc_queue { // Named the STL way
+
+	public:
+		// Types
+		typedef T value_type;
+
+
+		// Constructors
+		mpsc_queue () : stub_{}, head_{&stub_}, tail_{&stub_} {
+			stub_.next.store(nullptr, std::memory_order_relaxed);
+		}
+
+		mpsc_queue (const mpsc_queue&) = delete;
+
+		mpsc_queue& operator= (const mpsc_queue&) = delete;
+
+		~mpsc_queue () {
+			T value;
+			while (try_pop(value)) {}
+		}
+
+
+		/// Adds value at the end of the queue (lock-free, any thread).
+		void push (T value) {
+			node* n = new node(std::move(value));
+			node* previous = head_.exchange(n, std::memory_order_acq_rel);
+			previous->next.store(n, std::memory_order_release);
+		}
+
+		/** Moves the first element of the queue to value and removes it from the
+		  * queue, or returns false if there is none (consumer thread only). */
+		bool try_pop (T& value) {
+			node* tail = tail_;
+			node* next = tail->next.load(std::memory_order_acquire);
+			if (tail == &stub_) {
+				if (next == nullptr) {
+					return false;
+				}
+				tail_ = next;
+				tail = next;
+				next = next->next.load(std::memory_order_acquire);
+			}
+			if (next != nullptr) {
+				tail_ = next;
+				value = std::move(tail->value);
+				delete tail;
+				return true;
+			}
+			if (tail != head_.load(std::memory_order_acquire)) {
+				// A producer is linking a new node after tail
+				return false;
+			}
+			// tail is the last node: the stub is pushed back behind it so that
+			// tail can be removed
+			stub_.next.store(nullptr, std::memory_order_relaxed);
+			node* previous = head_.exchange(&stub_, std::memory_order_acq_rel);
+			previous->next.store(&stub_, std::memory_order_release);
+			next = tail->next.load(std::memory_order_acquire);
+			if (next != nullptr) {
+				tail_ = next;
+				value = std::move(tail->value);
+				delete tail;
+				return true;
+			}
+			return false;
+		}
+
+		/// Whether the queue seems empty (consumer thread only).
+		bool empty () const {
+			node* tail = tail_;
+			node* next = tail->next.load(std::memory_order_acquire);
+			return tail == &stub_ && next == nullptr;
+		}
+
+	private:
+		struct node {
+			node () : value{}, next{nullptr} {}
+			explicit node (T&& v) : value{std::move(v)}, next{nullptr} {}
+			T value;
+			std::atomic<node*> next;
+		};
+
+		node stub_;
+		std::atomic<node*> head_;
+		node* tail_;
+
+	};
+
+}
+
+#endif
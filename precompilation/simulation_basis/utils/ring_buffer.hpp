@@ -0,0 +1,87 @@
+/**
+ * \file ring_buffer.hpp
+ * \brief Implements fixed capacity buffers keeping the last elements pushed
+ *        (utils::ring_buffer).
+ */
+
+#ifndef RING_BUFFER_HPP_
+#define RING_BUFFER_HPP_
+
+#include <vector>    // std::vector
+#include <cstddef>   // std::size_t
+#include <stdexcept> // std::out_of_range exception
+
+
+namespace utils {
+
+	/**
+	 * \class ring_buffer
+	 *
+	 * \brief ring_buffer stores the last capacity() elements pushed in it,
+	 * overwriting the oldest ones once it is full.
+	 *
+	 * \details Pushing never allocates nor locks, so that a ring_buffer owned
+	 * by a thread can be filled at a negligible cost. A ring_buffer is not
+	 * thread safe: it must be written by a single thread, and read once this
+	 * thread has been synchronized with the reader (e.g. joined).
+	 *
+	 */
+	template <class T>
+	class ring_buffer { // Named the STL way
+
+	public:
+		// Types
+		typedef T value_type;
+		typedef std::size_t size_type;
+
+
+		// Constructors
+		explicit ring_buffer (size_type capacity = 0) : elements_(capacity), pushed_{0} {}
+
+
+		/// Adds value to the buffer, replacing the oldest element if it is full.
+		void push (const T& value) {
+			if (elements_.empty()) {
+				return;
+			}
+			elements_[pushed_%elements_.size()] = value;
+			pushed_++;
+		}
+
+		/// Number of elements currently stored.
+		size_type size () const {
+			return pushed_ < elements_.size() ? pushed_ : elements_.size();
+		}
+
+		/// Maximal number of elements stored.
+		size_type capacity () const {
+			return elements_.size();
+		}
+
+		/// Number of elements which were overwritten since the last clear.
+		size_type dropped () const {
+			return pushed_ - size();
+		}
+
+		/// Returns the i-th stored element, the oldest one being at index 0.
+		const T& at (size_type i) const {
+			if (i >= size()) {
+				throw std::out_of_range("ring_buffer::at");
+			}
+			return elements_[(pushed_ - size() + i)%elements_.size()];
+		}
+
+		/// Removes all the elements, keeping the capacity.
+		void clear () {
+			pushed_ = 0;
+		}
+
+	private:
+		std::vector<T> elements_;
+		size_type pushed_;
+
+	};
+
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "generate_compilable_code.hpp"
 
@@ -549,17 +550,20 @@ std::string GenerateUserInterfaceModelCpp(Model &model) {
 	       << "#include <vector>\n"
 	       << "#include <string>\n"
 	       << "#include <stdexcept>\n"
+	       << "#include <algorithm>\n"
+	       << "#include <unordered_map>\n"
 	       << "#include \"master.hpp\"\n"
 	       << "#include \"user_interface_model.hpp\"\n"
 	       << "#include \"utils/memory.hpp\"\n"
 	       << "#include \"simulation_structs.hpp\"\n"
+	       << "#include \"libs/ubjsoncpp/include/value.hpp\"\n"
 
 	       << "#include \"libs/jeayeson/include/jeayeson/jeayeson.hpp\"\n"
 	       << "#include \"libs/jeayeson/include/jeayeson/value.hpp\"\n"
 	       << "\n";
 
 	// Begining of the function which parses the input
-	stream << "void ParseModelCommand(const char *buffer, std::unique_ptr<Master> &root_master, bool is_alive) {\n"
+	stream << "bool ParseModelCommand(const char *buffer, std::unique_ptr<Master> &root_master, bool is_alive) {\n"
 	       << "\tstd::istringstream input(buffer);\n"
 	       << "\tstd::string command; input >> command;\n";
 
@@ -574,20 +578,60 @@ std::string GenerateUserInterfaceModelCpp(Model &model) {
 
 	stream <<"\";\n";
 
-	// Command print_agent
-	stream << "\t} else if (command == \"print_agent\") {\n";
-
+	// Command print_agent <type> <id> [attributes...]
+	stream << "\t} else if (command == \"print_agent\") {\n"
+	       << "\t\tif (!is_alive) {\n"
+	       << "\t\t\tstd::cerr << \"No simulation has been initiated. Execute first a 'init'.\\n\";\n"
+	       << "\t\t\treturn false;\n"
+	       << "\t\t}\n"
+	       << "\t\tstd::string type_name;\n"
+	       << "\t\tAgentId id;\n"
+	       << "\t\tif (!(input >> type_name >> id)) {\n"
+	       << "\t\t\tstd::cerr << \"Usage: print_agent <type> <id> [attributes...]\\n\";\n"
+	       << "\t\t\treturn false;\n"
+	       << "\t\t}\n"
+	       << "\t\tconst std::unordered_map<std::string, AgentType> types = {";
+	for (const auto &agent : model.GetAgents()) {
+		stream << "{\"" << agent.first << "\", " << agent.second.GetId() << "}, ";
+	}
+	stream << "};\n"
+	       << "\t\tauto type = types.find(type_name);\n"
+	       << "\t\tif (type == types.end()) {\n"
+	       << "\t\t\tstd::cerr << \"The agent type \" << type_name << \" does not exist.\\n\";\n"
+	       << "\t\t\treturn false;\n"
+	       << "\t\t}\n"
+	       << "\t\tubjson::Value agent = root_master->GetAgentJsonNode(id, type->second);\n"
+	       << "\t\tif (agent.isNull()) {\n"
+	       << "\t\t\treturn false;\n"
+	       << "\t\t}\n"
+	       // Only the selected attributes are kept, if any
+	       << "\t\tstd::string attribute;\n"
+	       << "\t\tif (input >> attribute) {\n"
+	       << "\t\t\tubjson::Value::Keys names = agent[\"attributes\"].keys();\n"
+	       << "\t\t\tubjson::Value selected;\n"
+	       << "\t\t\tdo {\n"
+	       << "\t\t\t\tif (std::find(names.begin(), names.end(), attribute) == names.end()) {\n"
+	       << "\t\t\t\t\tstd::cerr << \"The agent type \" << type_name << \" has no sendable attribute \" << attribute << \".\\n\";\n"
+	       << "\t\t\t\t\treturn false;\n"
+	       << "\t\t\t\t}\n"
+	       << "\t\t\t\tselected[attribute] = agent[\"attributes\"][attribute];\n"
+	       << "\t\t\t} while (input >> attribute);\n"
+	       << "\t\t\tagent[\"attributes\"] = std::move(selected);\n"
+	       << "\t\t}\n"
+	       << "\t\tagent[\"type\"] = type_name;\n"
+	       << "\t\tstd::cout << ubjson::to_ostream(agent, ubjson::to_ostream::pretty) << std::endl;\n";
 
 	stream << "\t}\n"
+	       << "\treturn true;\n"
 	       << "}\n\n";
 
 
 
-	// Function std::vector<void*> Instanciate(std::string file);
+	// Function std::vector<void*> InstanciateMap(json_map &map), shared by
+	// Instanciate and InstanciateData
 
-	stream << "std::vector<void*> Instanciate(std::string file) try {\n"
+	stream << "static std::vector<void*> InstanciateMap(json_map &map) try {\n"
 	       << "\tstd::vector<void*> pointers;\n"
-	       << "\tjson_map map{json_file{file}};\n"
 	       << "\tfor (auto &type : map[\"agent_types\"].as<json_array>()) {\n"
 	       << "\t\tauto start = pointers.size();\n"
 	       << "\t\tstd::array<unsigned long long, " << model.GetAgents().size() << "> ids;\n"
@@ -647,5 +691,21 @@ std::string GenerateUserInterfaceModelCpp(Model &model) {
 		   << "} catch (...) {\n"
 		   << "\tthrow InstanciateException(\"unknown error\");\n"
 		   << "}\n\n";
+
+	// Functions std::vector<void*> Instanciate(std::string file) and
+	// std::vector<void*> InstanciateData(const std::string &json)
+	const std::vector<std::pair<std::string, std::string>> sources = {
+		{"Instanciate(std::string file)", "json_file{file}"},
+		{"InstanciateData(const std::string &json)", "json_data{json}"}};
+	for (const auto &source : sources) {
+		stream << "std::vector<void*> " << source.first << " try {\n"
+		       << "\tjson_map map{" << source.second << "};\n"
+		       << "\treturn InstanciateMap(map);\n"
+		       << "} catch (const InstanciateException&) {\n"
+		       << "\tthrow;\n"
+		       << "} catch (const std::exception& e) {\n"
+		       << "\tthrow InstanciateException(e);\n"
+		       << "}\n\n";
+	}
 	return stream.str();
 }
@@ -459,6 +459,22 @@ std::string GenerateAttributesNamesRelation(Model &model) {
 }
 
 
+std::string GenerateInteractionsNames(Model &model) {
+	std::stringstream stream;
+	// Add prototype
+	stream << "void CreateInteractionsNames(\n"
+		"\tstd::vector<InteractionName> &interaction_type_to_string) {\n"
+		"\tinteraction_type_to_string.resize(" << model.GetInteractions().size() << ");\n";
+
+	for (const auto &interaction : model.GetInteractions()) {
+		stream << "\tinteraction_type_to_string[" << interaction.second.GetId() << "] = \"" << interaction.first << "\";\n";
+	}
+	stream << "}\n";
+
+	return stream.str();
+}
+
+
 std::string GenerateNbAgentTypesFunction(Model &model) {
 	std::stringstream stream;
 
@@ -520,6 +536,7 @@ std::string GenerateMasterInitialization(Model &model, clang::ASTContext *contex
 		   << GenerateCriticalStructSizesFunction(model) << "\n"
 		   << GenerateAgentsNamesRelation(model) << "\n"
 		   << GenerateAttributesNamesRelation(model) << "\n"
+		   << GenerateInteractionsNames(model) << "\n"
 		   << GenerateNbAgentTypesFunction(model) << "\n"
 		   << GenerateNbInteractionTypesFunction(model) << "\n";
 
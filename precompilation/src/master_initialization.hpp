@@ -84,6 +84,12 @@ std::string GenerateAgentsNamesRelation(Model &model);
  */
 std::string GenerateAttributesNamesRelation(Model &model);
 
+/**
+ * Generates the code that will build the names (strings) of the interaction
+ * types in the agent.
+ */
+std::string GenerateInteractionsNames(Model &model);
+
 /**
  * Generates the code that returns the (constant) number of agent classes
  */
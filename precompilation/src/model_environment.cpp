@@ -101,6 +101,7 @@ std::string GenerateAgentHeaderContent(Model &model) {
 		   << "#include <stdexcept>" << std::endl
 		   << "#include <iostream>" << std::endl
 		   << "#include <set>" << std::endl
+		   << "#include <memory>" << std::endl
 		   << "#include \"agent_data_access.hpp\"" << std::endl
 		   << "#define " << TAG_CRITICAL << "\n";
 	
@@ -132,6 +133,8 @@ std::string GenerateAgentHeaderContent(Model &model) {
 		   << "\tuint64_t TimeStep();" << std::endl
 		   << "\tbool DoesAgentExist(uint64_t id, uint64_t type);\n"
 		   << "\tuint64_t AgentIdTypeBound(uint64_t type);\n"
+		   << "\tuint64_t CreateAgent(std::unique_ptr<Agent> &&child);\n"
+		   << "\tvoid Die();\n"
 		   << "\tconst std::set<uint64_t> &GetAgentsOfType(uint64_t type) {std::set<uint64_t> *set = new std::set<uint64_t>(); return *set;}\n";
 
 	stream << "};" << std::endl;